@@ -0,0 +1,84 @@
+#include "arena.h"
+#include <stddef.h>
+#include <stdio.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT (sizeof(max_align_t))
+
+struct ArenaBlock
+{
+    ArenaBlock *next;
+    size_t capacity;
+    size_t used;
+    max_align_t data[];
+};
+
+static ArenaBlock *arena_new_block(size_t capacity);
+
+void arena_init(Arena *arena)
+{
+    arena->blocks = NULL;
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+    size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+
+    if (size > ARENA_BLOCK_SIZE / 4)
+    {
+        // Large requests get a block of their own behind the current one so
+        // the space left in the current block is not thrown away.
+        ArenaBlock *block = arena_new_block(size);
+        block->used = size;
+        if (arena->blocks == NULL)
+        {
+            arena->blocks = block;
+        }
+        else
+        {
+            block->next = arena->blocks->next;
+            arena->blocks->next = block;
+        }
+        return block->data;
+    }
+
+    ArenaBlock *block = arena->blocks;
+    if (block == NULL || block->used + size > block->capacity)
+    {
+        block = arena_new_block(ARENA_BLOCK_SIZE);
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+
+    void *result = (char *)block->data + block->used;
+    block->used += size;
+    return result;
+}
+
+void arena_free(Arena *arena)
+{
+    ArenaBlock *block = arena->blocks;
+    while (block != NULL)
+    {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    arena_init(arena);
+}
+
+static ArenaBlock *arena_new_block(size_t capacity)
+{
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + capacity);
+    if (block == NULL)
+    {
+        fprintf(stderr, "Out of memory.\n");
+        exit(74);
+    }
+
+    block->next = NULL;
+    block->capacity = capacity;
+    block->used = 0;
+    return block;
+}
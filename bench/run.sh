@@ -0,0 +1,12 @@
+#!/bin/bash
+# Times every script in bench/ with each lox binary given, on both engines,
+# e.g. `bash bench/run.sh ./lox /tmp/lox-before`.
+TIMEFORMAT='%3U s user, %3S s sys'
+for script in bench/*.lox; do
+    for lox in "$@"; do
+        for engine in tree vm; do
+            echo -n "$script $engine $lox: "
+            { time "$lox" --engine=$engine "$script" >/dev/null 2>&1; } 2>&1
+        done
+    done
+done
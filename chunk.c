@@ -0,0 +1,62 @@
+#include "chunk.h"
+#include <stdlib.h>
+
+void chunk_init(Chunk *chunk)
+{
+    chunk->count = 0;
+    chunk->capacity = 0;
+    chunk->code = NULL;
+    chunk->constants_capacity = 0;
+    chunk->constants = (Literals){
+        .count = 0,
+        .value = NULL,
+    };
+    chunk->names_capacity = 0;
+    chunk->names = (Tokens){
+        .count = 0,
+        .value = NULL,
+    };
+}
+
+void chunk_write(Chunk *chunk, uint8_t byte)
+{
+    if (chunk->count == chunk->capacity)
+    {
+        chunk->capacity = chunk->capacity < 8 ? 8 : chunk->capacity * 2;
+        chunk->code = realloc(chunk->code, chunk->capacity * sizeof(uint8_t));
+    }
+
+    chunk->code[chunk->count++] = byte;
+}
+
+size_t chunk_add_constant(Chunk *chunk, Literal literal)
+{
+    if (chunk->constants.count == chunk->constants_capacity)
+    {
+        chunk->constants_capacity = chunk->constants_capacity < 8 ? 8 : chunk->constants_capacity * 2;
+        chunk->constants.value = realloc(chunk->constants.value, chunk->constants_capacity * sizeof(Literal));
+    }
+
+    chunk->constants.value[chunk->constants.count] = literal;
+    return chunk->constants.count++;
+}
+
+size_t chunk_add_name(Chunk *chunk, Token *name)
+{
+    if (chunk->names.count == chunk->names_capacity)
+    {
+        chunk->names_capacity = chunk->names_capacity < 8 ? 8 : chunk->names_capacity * 2;
+        chunk->names.value = realloc(chunk->names.value, chunk->names_capacity * sizeof(Token *));
+    }
+
+    chunk->names.value[chunk->names.count] = name;
+    return chunk->names.count++;
+}
+
+void chunk_free(Chunk *chunk)
+{
+    free(chunk->code);
+    free(chunk->constants.value);
+    free(chunk->names.value);
+    chunk_init(chunk);
+}
@@ -0,0 +1,71 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include "token.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef enum
+{
+    OP_CODE_CONSTANT,
+    OP_CODE_NONE,
+    OP_CODE_TRUE,
+    OP_CODE_FALSE,
+    OP_CODE_POP,
+    OP_CODE_GET_LOCAL,
+    OP_CODE_SET_LOCAL,
+    OP_CODE_GET_GLOBAL,
+    OP_CODE_DEFINE_GLOBAL,
+    OP_CODE_SET_GLOBAL,
+    OP_CODE_GET_UPVALUE,
+    OP_CODE_SET_UPVALUE,
+    OP_CODE_EQUAL,
+    OP_CODE_GREATER,
+    OP_CODE_GREATER_EQUAL,
+    OP_CODE_LESS,
+    OP_CODE_LESS_EQUAL,
+    OP_CODE_ADD,
+    OP_CODE_SUBTRACT,
+    OP_CODE_MULTIPLY,
+    OP_CODE_DIVIDE,
+    OP_CODE_NOT,
+    OP_CODE_NEGATE,
+    OP_CODE_PRINT,
+    OP_CODE_JUMP,
+    OP_CODE_JUMP_IF_FALSE,
+    OP_CODE_LOOP,
+    OP_CODE_CALL,
+    OP_CODE_TAIL_CALL,
+    OP_CODE_CLOSURE,
+    OP_CODE_CLOSE_UPVALUE,
+    OP_CODE_RETURN,
+} OpCode;
+
+typedef struct
+{
+    size_t count;
+    size_t capacity;
+    uint8_t *code;
+    size_t constants_capacity;
+    Literals constants;
+    size_t names_capacity;
+    Tokens names;
+} Chunk;
+
+struct CompiledFunction
+{
+    size_t arity;
+    // Deepest the stack gets above the frame's slots while this runs.
+    size_t max_stack;
+    size_t upvalue_count;
+    Chunk chunk;
+    Token *name;
+};
+
+void chunk_init(Chunk *chunk);
+void chunk_write(Chunk *chunk, uint8_t byte);
+size_t chunk_add_constant(Chunk *chunk, Literal literal);
+size_t chunk_add_name(Chunk *chunk, Token *name);
+void chunk_free(Chunk *chunk);
+
+#endif
@@ -0,0 +1,761 @@
+#include "compiler.h"
+#include "table.h"
+#include <stdio.h>
+#include <stdint.h>
+
+#define COMPILER_MAX_LOCALS 256
+#define COMPILER_MAX_UPVALUES 256
+
+typedef struct
+{
+    Token *name;
+    int depth;
+    bool is_captured;
+} Local;
+
+// A variable of an enclosing function: either a slot of the immediately
+// enclosing frame or one of that function's own upvalues.
+typedef struct
+{
+    uint8_t index;
+    bool is_local;
+} Upvalue;
+
+typedef struct Compiler Compiler;
+
+struct Compiler
+{
+    Compiler *enclosing;
+    CompiledFunction *function;
+    Local locals[COMPILER_MAX_LOCALS];
+    size_t locals_count;
+    Upvalue upvalues[COMPILER_MAX_UPVALUES];
+    int scope_depth;
+    size_t stack_depth;
+    Table names;
+};
+
+static Compiler *current = NULL;
+static bool had_error = false;
+
+// Net change each instruction makes to the stack; calls depend on their
+// argument count and are adjusted where they are emitted.
+static const int compiler_stack_effects[] = {
+    [OP_CODE_CONSTANT] = 1,
+    [OP_CODE_NONE] = 1,
+    [OP_CODE_TRUE] = 1,
+    [OP_CODE_FALSE] = 1,
+    [OP_CODE_POP] = -1,
+    [OP_CODE_GET_LOCAL] = 1,
+    [OP_CODE_SET_LOCAL] = 0,
+    [OP_CODE_GET_GLOBAL] = 1,
+    [OP_CODE_DEFINE_GLOBAL] = -1,
+    [OP_CODE_SET_GLOBAL] = 0,
+    [OP_CODE_GET_UPVALUE] = 1,
+    [OP_CODE_SET_UPVALUE] = 0,
+    [OP_CODE_EQUAL] = -1,
+    [OP_CODE_GREATER] = -1,
+    [OP_CODE_GREATER_EQUAL] = -1,
+    [OP_CODE_LESS] = -1,
+    [OP_CODE_LESS_EQUAL] = -1,
+    [OP_CODE_ADD] = -1,
+    [OP_CODE_SUBTRACT] = -1,
+    [OP_CODE_MULTIPLY] = -1,
+    [OP_CODE_DIVIDE] = -1,
+    [OP_CODE_NOT] = 0,
+    [OP_CODE_NEGATE] = 0,
+    [OP_CODE_PRINT] = -1,
+    [OP_CODE_JUMP] = 0,
+    [OP_CODE_JUMP_IF_FALSE] = 0,
+    [OP_CODE_LOOP] = 0,
+    [OP_CODE_CALL] = 0,
+    [OP_CODE_TAIL_CALL] = 0,
+    [OP_CODE_CLOSURE] = 1,
+    [OP_CODE_CLOSE_UPVALUE] = -1,
+    [OP_CODE_RETURN] = -1,
+};
+
+static void compiler_begin(Compiler *compiler, Token *name, size_t arity);
+static CompiledFunction *compiler_end(void);
+static void compiler_error(const char *message);
+static Chunk *compiler_chunk(void);
+static void compiler_emit_byte(uint8_t byte);
+static void compiler_emit_op(OpCode op_code);
+static void compiler_adjust_stack(int effect);
+static void compiler_emit_short(uint16_t value);
+static void compiler_emit_constant(Literal literal);
+static uint16_t compiler_make_constant(Literal literal);
+static uint16_t compiler_make_name(Token *name);
+static size_t compiler_emit_jump(OpCode op_code);
+static void compiler_patch_jump(size_t offset);
+static void compiler_emit_loop(size_t loop_start);
+static void compiler_begin_scope(void);
+static void compiler_end_scope(void);
+static void compiler_add_local(Token *name);
+static int compiler_resolve_local(Compiler *compiler, Token *name);
+static int compiler_resolve_upvalue(Compiler *compiler, Token *name);
+static int compiler_add_upvalue(Compiler *compiler, uint8_t index, bool is_local);
+static void compiler_named_variable(Token *name, bool is_assign);
+static void compiler_define_variable(Token *name);
+static void compiler_statements(Statements *statements);
+static void compiler_statement(Stmt *stmt);
+static void compiler_expression(Expr *expr);
+static void compiler_visit_block_stmt(StmtBlock *stmt);
+static void compiler_visit_function_stmt(StmtFunction *stmt);
+static void compiler_visit_return_stmt(StmtReturn *stmt);
+static void compiler_visit_expression_stmt(StmtExpr *stmt);
+static void compiler_visit_if_stmt(StmtIf *stmt);
+static void compiler_visit_print_stmt(StmtPrint *stmt);
+static void compiler_visit_while_stmt(StmtWhile *stmt);
+static void compiler_visit_var_stmt(StmtVar *stmt);
+static void compiler_visit_literal_expr(ExprLiteral *expr);
+static void compiler_visit_assign_expr(ExprAssign *expr);
+static void compiler_visit_var_expr(ExprVariable *expr);
+static void compiler_visit_unary_expr(ExprUnary *expr);
+static void compiler_visit_binary_expr(ExprBinary *expr);
+static void compiler_visit_logical_expr(ExprLogical *expr);
+static void compiler_visit_call_expr(ExprCall *expr);
+
+CompiledFunction *compiler_compile(Statements *statements)
+{
+    Compiler compiler;
+    had_error = false;
+    compiler_begin(&compiler, NULL, 0);
+    compiler_statements(statements);
+    CompiledFunction *function = compiler_end();
+
+    if (had_error)
+    {
+        compiler_free(function);
+        return NULL;
+    }
+
+    return function;
+}
+
+void compiler_free(CompiledFunction *function)
+{
+    for (size_t i = 0; i < function->chunk.constants.count; ++i)
+    {
+        Literal constant = function->chunk.constants.value[i];
+        if (literal_is_compiled_function(constant))
+        {
+            compiler_free(literal_as_compiled_function(constant));
+        }
+    }
+
+    chunk_free(&function->chunk);
+    free(function);
+}
+
+static void compiler_begin(Compiler *compiler, Token *name, size_t arity)
+{
+    CompiledFunction *function = malloc(sizeof(CompiledFunction));
+    function->arity = arity;
+    function->max_stack = 1 + arity;
+    function->upvalue_count = 0;
+    function->name = name;
+    chunk_init(&function->chunk);
+
+    compiler->enclosing = current;
+    compiler->function = function;
+    compiler->locals_count = 0;
+    compiler->scope_depth = 0;
+    // The callee and its arguments are already on the stack when it starts.
+    compiler->stack_depth = 1 + arity;
+    table_init(&compiler->names);
+
+    // Slot zero holds the function being called.
+    compiler->locals[compiler->locals_count++] = (Local){
+        .name = NULL,
+        .depth = 0,
+        .is_captured = false,
+    };
+
+    current = compiler;
+}
+
+static CompiledFunction *compiler_end(void)
+{
+    compiler_emit_op(OP_CODE_NONE);
+    compiler_emit_op(OP_CODE_RETURN);
+
+    CompiledFunction *function = current->function;
+    table_free(&current->names);
+    current = current->enclosing;
+    return function;
+}
+
+static void compiler_error(const char *message)
+{
+    had_error = true;
+    fprintf(stderr, "%s\n", message);
+}
+
+static Chunk *compiler_chunk(void)
+{
+    return &current->function->chunk;
+}
+
+static void compiler_emit_byte(uint8_t byte)
+{
+    chunk_write(compiler_chunk(), byte);
+}
+
+static void compiler_emit_op(OpCode op_code)
+{
+    compiler_emit_byte(op_code);
+    compiler_adjust_stack(compiler_stack_effects[op_code]);
+}
+
+static void compiler_adjust_stack(int effect)
+{
+    current->stack_depth = (size_t)((long)current->stack_depth + effect);
+    if (current->stack_depth > current->function->max_stack)
+    {
+        current->function->max_stack = current->stack_depth;
+    }
+}
+
+static void compiler_emit_short(uint16_t value)
+{
+    compiler_emit_byte((value >> 8) & 0xff);
+    compiler_emit_byte(value & 0xff);
+}
+
+static void compiler_emit_constant(Literal literal)
+{
+    compiler_emit_op(OP_CODE_CONSTANT);
+    compiler_emit_short(compiler_make_constant(literal));
+}
+
+static uint16_t compiler_make_constant(Literal literal)
+{
+    size_t constant = chunk_add_constant(compiler_chunk(), literal);
+    if (constant > UINT16_MAX)
+    {
+        compiler_error("Too many constants in one chunk.");
+        return 0;
+    }
+
+    return (uint16_t)constant;
+}
+
+static uint16_t compiler_make_name(Token *name)
+{
+    Literal *existing = table_get(&current->names, name->name);
+    if (existing != NULL)
+    {
+        return (uint16_t)literal_as_number(*existing);
+    }
+
+    size_t index = chunk_add_name(compiler_chunk(), name);
+    if (index > UINT16_MAX)
+    {
+        compiler_error("Too many global variables in one chunk.");
+        return 0;
+    }
+
+    table_set(&current->names, name->name, literal_number((double)index));
+    return (uint16_t)index;
+}
+
+static size_t compiler_emit_jump(OpCode op_code)
+{
+    compiler_emit_op(op_code);
+    compiler_emit_short(0xffff);
+    return compiler_chunk()->count - 2;
+}
+
+static void compiler_patch_jump(size_t offset)
+{
+    size_t jump = compiler_chunk()->count - offset - 2;
+    if (jump > UINT16_MAX)
+    {
+        compiler_error("Too much code to jump over.");
+    }
+
+    compiler_chunk()->code[offset] = (jump >> 8) & 0xff;
+    compiler_chunk()->code[offset + 1] = jump & 0xff;
+}
+
+static void compiler_emit_loop(size_t loop_start)
+{
+    compiler_emit_op(OP_CODE_LOOP);
+
+    size_t offset = compiler_chunk()->count - loop_start + 2;
+    if (offset > UINT16_MAX)
+    {
+        compiler_error("Loop body too large.");
+    }
+
+    compiler_emit_short((uint16_t)offset);
+}
+
+static void compiler_begin_scope(void)
+{
+    current->scope_depth++;
+}
+
+static void compiler_end_scope(void)
+{
+    current->scope_depth--;
+
+    while (current->locals_count > 0 && current->locals[current->locals_count - 1].depth > current->scope_depth)
+    {
+        compiler_emit_op(current->locals[current->locals_count - 1].is_captured ? OP_CODE_CLOSE_UPVALUE : OP_CODE_POP);
+        current->locals_count--;
+    }
+}
+
+static void compiler_add_local(Token *name)
+{
+    if (current->locals_count == COMPILER_MAX_LOCALS)
+    {
+        compiler_error("Too many local variables in function.");
+        return;
+    }
+
+    current->locals[current->locals_count++] = (Local){
+        .name = name,
+        .depth = current->scope_depth,
+        .is_captured = false,
+    };
+}
+
+static int compiler_resolve_local(Compiler *compiler, Token *name)
+{
+    for (size_t i = compiler->locals_count; i > 0; --i)
+    {
+        if (compiler->locals[i - 1].name != NULL && token_equal(compiler->locals[i - 1].name, name))
+        {
+            return (int)(i - 1);
+        }
+    }
+
+    return -1;
+}
+
+static int compiler_resolve_upvalue(Compiler *compiler, Token *name)
+{
+    if (compiler->enclosing == NULL)
+    {
+        return -1;
+    }
+
+    int local = compiler_resolve_local(compiler->enclosing, name);
+    if (local >= 0)
+    {
+        compiler->enclosing->locals[local].is_captured = true;
+        return compiler_add_upvalue(compiler, (uint8_t)local, true);
+    }
+
+    int upvalue = compiler_resolve_upvalue(compiler->enclosing, name);
+    if (upvalue >= 0)
+    {
+        return compiler_add_upvalue(compiler, (uint8_t)upvalue, false);
+    }
+
+    return -1;
+}
+
+static int compiler_add_upvalue(Compiler *compiler, uint8_t index, bool is_local)
+{
+    size_t count = compiler->function->upvalue_count;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (compiler->upvalues[i].index == index && compiler->upvalues[i].is_local == is_local)
+        {
+            return (int)i;
+        }
+    }
+
+    if (count == COMPILER_MAX_UPVALUES)
+    {
+        compiler_error("Too many closure variables in function.");
+        return 0;
+    }
+
+    compiler->upvalues[count] = (Upvalue){
+        .index = index,
+        .is_local = is_local,
+    };
+    return (int)compiler->function->upvalue_count++;
+}
+
+static void compiler_named_variable(Token *name, bool is_assign)
+{
+    int slot = compiler_resolve_local(current, name);
+    if (slot >= 0)
+    {
+        compiler_emit_op(is_assign ? OP_CODE_SET_LOCAL : OP_CODE_GET_LOCAL);
+        compiler_emit_byte((uint8_t)slot);
+        return;
+    }
+
+    int upvalue = compiler_resolve_upvalue(current, name);
+    if (upvalue >= 0)
+    {
+        compiler_emit_op(is_assign ? OP_CODE_SET_UPVALUE : OP_CODE_GET_UPVALUE);
+        compiler_emit_byte((uint8_t)upvalue);
+        return;
+    }
+
+    compiler_emit_op(is_assign ? OP_CODE_SET_GLOBAL : OP_CODE_GET_GLOBAL);
+    compiler_emit_short(compiler_make_name(name));
+}
+
+static void compiler_define_variable(Token *name)
+{
+    if (current->scope_depth > 0)
+    {
+        compiler_add_local(name);
+        return;
+    }
+
+    compiler_emit_op(OP_CODE_DEFINE_GLOBAL);
+    compiler_emit_short(compiler_make_name(name));
+}
+
+static void compiler_statements(Statements *statements)
+{
+    for (size_t i = 0; i < statements->count; ++i)
+    {
+        compiler_statement(statements->value[i]);
+    }
+}
+
+static void compiler_statement(Stmt *stmt)
+{
+    switch (stmt->type)
+    {
+    case STMT_TYPE_FUNCTION:
+        compiler_visit_function_stmt(&stmt->as.function);
+        break;
+    case STMT_TYPE_BLOCK:
+        compiler_visit_block_stmt(&stmt->as.block);
+        break;
+    case STMT_TYPE_EXPRESSION:
+        compiler_visit_expression_stmt(&stmt->as.expr);
+        break;
+    case STMT_TYPE_IF:
+        compiler_visit_if_stmt(&stmt->as.iff);
+        break;
+    case STMT_TYPE_PRINT:
+        compiler_visit_print_stmt(&stmt->as.print);
+        break;
+    case STMT_TYPE_WHILE:
+        compiler_visit_while_stmt(&stmt->as.whilee);
+        break;
+    case STMT_TYPE_VAR:
+        compiler_visit_var_stmt(&stmt->as.var);
+        break;
+    case STMT_TYPE_RETURN:
+        compiler_visit_return_stmt(&stmt->as.returnn);
+        break;
+    default:
+        break;
+    }
+}
+
+static void compiler_expression(Expr *expr)
+{
+    switch (expr->type)
+    {
+    case EXPR_TYPE_LITERAL:
+        compiler_visit_literal_expr(&expr->as.literal);
+        break;
+    case EXPR_TYPE_GROUPING:
+        compiler_expression(expr->as.grouping.expr);
+        break;
+    case EXPR_TYPE_UNARY:
+        compiler_visit_unary_expr(&expr->as.unary);
+        break;
+    case EXPR_TYPE_BINARY:
+        compiler_visit_binary_expr(&expr->as.binary);
+        break;
+    case EXPR_TYPE_LOGICAL:
+        compiler_visit_logical_expr(&expr->as.logical);
+        break;
+    case EXPR_TYPE_ASSIGN:
+        compiler_visit_assign_expr(&expr->as.assign);
+        break;
+    case EXPR_TYPE_VARIABLE:
+        compiler_visit_var_expr(&expr->as.variable);
+        break;
+    case EXPR_TYPE_CALL:
+        compiler_visit_call_expr(&expr->as.call);
+        break;
+    default:
+        compiler_emit_op(OP_CODE_NONE);
+        break;
+    }
+}
+
+static void compiler_visit_block_stmt(StmtBlock *stmt)
+{
+    compiler_begin_scope();
+    compiler_statements(&stmt->statements);
+    compiler_end_scope();
+}
+
+static void compiler_visit_function_stmt(StmtFunction *stmt)
+{
+    if (current->scope_depth > 0)
+    {
+        compiler_add_local(stmt->name);
+    }
+
+    Compiler compiler;
+    compiler_begin(&compiler, stmt->name, stmt->params.count);
+    compiler_begin_scope();
+
+    for (size_t i = 0; i < stmt->params.count; ++i)
+    {
+        compiler_add_local(stmt->params.value[i]);
+    }
+
+    compiler_statements(&stmt->body);
+    CompiledFunction *function = compiler_end();
+
+    // Functions that capture nothing stay plain constants; the rest get a
+    // closure built around the variables they capture.
+    if (function->upvalue_count == 0)
+    {
+        compiler_emit_constant(literal_compiled_function(function));
+    }
+    else
+    {
+        compiler_emit_op(OP_CODE_CLOSURE);
+        compiler_emit_short(compiler_make_constant(literal_compiled_function(function)));
+        for (size_t i = 0; i < function->upvalue_count; ++i)
+        {
+            compiler_emit_byte(compiler.upvalues[i].is_local ? 1 : 0);
+            compiler_emit_byte(compiler.upvalues[i].index);
+        }
+    }
+
+    if (current->scope_depth == 0)
+    {
+        compiler_define_variable(stmt->name);
+    }
+}
+
+static void compiler_visit_return_stmt(StmtReturn *stmt)
+{
+    if (current->enclosing != NULL && stmt->value != NULL && stmt->value->type == EXPR_TYPE_CALL)
+    {
+        compiler_visit_call_expr(&stmt->value->as.call);
+        current->function->chunk.code[current->function->chunk.count - 2] = OP_CODE_TAIL_CALL;
+        compiler_adjust_stack(-1);
+        return;
+    }
+
+    if (stmt->value != NULL)
+    {
+        compiler_expression(stmt->value);
+    }
+    else
+    {
+        compiler_emit_op(OP_CODE_NONE);
+    }
+
+    compiler_emit_op(OP_CODE_RETURN);
+}
+
+static void compiler_visit_expression_stmt(StmtExpr *stmt)
+{
+    compiler_expression(stmt->expr);
+    compiler_emit_op(OP_CODE_POP);
+}
+
+static void compiler_visit_if_stmt(StmtIf *stmt)
+{
+    compiler_expression(stmt->condition);
+
+    size_t then_jump = compiler_emit_jump(OP_CODE_JUMP_IF_FALSE);
+    compiler_emit_op(OP_CODE_POP);
+    compiler_statement(stmt->then_branch);
+
+    size_t else_jump = compiler_emit_jump(OP_CODE_JUMP);
+    compiler_patch_jump(then_jump);
+    // The else path still has the condition on the stack.
+    compiler_adjust_stack(1);
+    compiler_emit_op(OP_CODE_POP);
+
+    if (stmt->else_branch != NULL)
+    {
+        compiler_statement(stmt->else_branch);
+    }
+
+    compiler_patch_jump(else_jump);
+}
+
+static void compiler_visit_print_stmt(StmtPrint *stmt)
+{
+    compiler_expression(stmt->value);
+    compiler_emit_op(OP_CODE_PRINT);
+}
+
+static void compiler_visit_while_stmt(StmtWhile *stmt)
+{
+    size_t loop_start = compiler_chunk()->count;
+    compiler_expression(stmt->condition);
+
+    size_t exit_jump = compiler_emit_jump(OP_CODE_JUMP_IF_FALSE);
+    compiler_emit_op(OP_CODE_POP);
+    compiler_statement(stmt->body);
+    if (stmt->increment != NULL)
+    {
+        compiler_expression(stmt->increment);
+        compiler_emit_op(OP_CODE_POP);
+    }
+    compiler_emit_loop(loop_start);
+
+    compiler_patch_jump(exit_jump);
+    compiler_adjust_stack(1);
+    compiler_emit_op(OP_CODE_POP);
+}
+
+static void compiler_visit_var_stmt(StmtVar *stmt)
+{
+    if (stmt->initializer != NULL)
+    {
+        compiler_expression(stmt->initializer);
+    }
+    else
+    {
+        compiler_emit_op(OP_CODE_NONE);
+    }
+
+    compiler_define_variable(stmt->name);
+}
+
+static void compiler_visit_literal_expr(ExprLiteral *expr)
+{
+    switch (literal_type(expr->literal))
+    {
+    case LITERAL_BOOL:
+        compiler_emit_op(literal_as_bool(expr->literal) ? OP_CODE_TRUE : OP_CODE_FALSE);
+        break;
+    case LITERAL_NONE:
+        compiler_emit_op(OP_CODE_NONE);
+        break;
+    default:
+        compiler_emit_constant(expr->literal);
+        break;
+    }
+}
+
+static void compiler_visit_assign_expr(ExprAssign *expr)
+{
+    compiler_expression(expr->value);
+    compiler_named_variable(expr->name, true);
+}
+
+static void compiler_visit_var_expr(ExprVariable *expr)
+{
+    compiler_named_variable(expr->name, false);
+}
+
+static void compiler_visit_unary_expr(ExprUnary *expr)
+{
+    compiler_expression(expr->expr);
+
+    switch (expr->operator->type)
+    {
+    case TOKEN_TYPE_BANG:
+        compiler_emit_op(OP_CODE_NOT);
+        break;
+    case TOKEN_TYPE_MINUS:
+        compiler_emit_op(OP_CODE_NEGATE);
+        break;
+    default:
+        break;
+    }
+}
+
+static void compiler_visit_binary_expr(ExprBinary *expr)
+{
+    compiler_expression(expr->left);
+    compiler_expression(expr->right);
+
+    switch (expr->operator->type)
+    {
+    case TOKEN_TYPE_GREATER:
+        compiler_emit_op(OP_CODE_GREATER);
+        break;
+    case TOKEN_TYPE_GREATER_EQUAL:
+        compiler_emit_op(OP_CODE_GREATER_EQUAL);
+        break;
+    case TOKEN_TYPE_LESS:
+        compiler_emit_op(OP_CODE_LESS);
+        break;
+    case TOKEN_TYPE_LESS_EQUAL:
+        compiler_emit_op(OP_CODE_LESS_EQUAL);
+        break;
+    case TOKEN_TYPE_MINUS:
+        compiler_emit_op(OP_CODE_SUBTRACT);
+        break;
+    case TOKEN_TYPE_PLUS:
+        compiler_emit_op(OP_CODE_ADD);
+        break;
+    case TOKEN_TYPE_SLASH:
+        compiler_emit_op(OP_CODE_DIVIDE);
+        break;
+    case TOKEN_TYPE_STAR:
+        compiler_emit_op(OP_CODE_MULTIPLY);
+        break;
+    case TOKEN_TYPE_BANG_EQUAL:
+        compiler_emit_op(OP_CODE_EQUAL);
+        compiler_emit_op(OP_CODE_NOT);
+        break;
+    case TOKEN_TYPE_EQUAL_EQUAL:
+        compiler_emit_op(OP_CODE_EQUAL);
+        break;
+    default:
+        break;
+    }
+}
+
+static void compiler_visit_logical_expr(ExprLogical *expr)
+{
+    compiler_expression(expr->left);
+
+    if (expr->operator->type == TOKEN_TYPE_OR)
+    {
+        size_t else_jump = compiler_emit_jump(OP_CODE_JUMP_IF_FALSE);
+        size_t end_jump = compiler_emit_jump(OP_CODE_JUMP);
+
+        compiler_patch_jump(else_jump);
+        compiler_emit_op(OP_CODE_POP);
+        compiler_expression(expr->right);
+        compiler_patch_jump(end_jump);
+        return;
+    }
+
+    size_t end_jump = compiler_emit_jump(OP_CODE_JUMP_IF_FALSE);
+    compiler_emit_op(OP_CODE_POP);
+    compiler_expression(expr->right);
+    compiler_patch_jump(end_jump);
+}
+
+static void compiler_visit_call_expr(ExprCall *expr)
+{
+    compiler_expression(expr->callee);
+
+    if (expr->arguments.count > UINT8_MAX)
+    {
+        compiler_error("Can't have more than 255 arguments.");
+        return;
+    }
+
+    for (size_t i = 0; i < expr->arguments.count; ++i)
+    {
+        compiler_expression(expr->arguments.value[i]);
+    }
+
+    compiler_emit_op(OP_CODE_CALL);
+    compiler_emit_byte((uint8_t)expr->arguments.count);
+    compiler_adjust_stack(-(int)expr->arguments.count);
+}
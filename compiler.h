@@ -0,0 +1,10 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "chunk.h"
+#include "stmt.h"
+
+CompiledFunction *compiler_compile(Statements *statements);
+void compiler_free(CompiledFunction *function);
+
+#endif
@@ -1,43 +1,162 @@
 #include "environment.h"
-#include <string.h>
+#include "memory.h"
 
-Literal *environment_get(Environment *environment, char *key)
+#define ENVIRONMENT_POOL_BLOCK_SIZE 4096
+
+typedef struct EnvironmentPoolBlock EnvironmentPoolBlock;
+
+struct EnvironmentPoolBlock
+{
+    EnvironmentPoolBlock *previous;
+    EnvironmentPoolBlock *next;
+    size_t capacity;
+    size_t used;
+    Entry entries[];
+};
+
+static EnvironmentPoolBlock *pool = NULL;
+
+static EnvironmentPoolBlock *environment_pool_next(size_t count);
+
+Literal *environment_get_at(Environment *environment, size_t depth, size_t slot)
 {
-    for (size_t i = 0; i < environment->entries.count; ++i)
+    for (size_t i = 0; i < depth; ++i)
     {
-        if (strcmp(environment->entries.value[i].key, key) == 0)
-        {
-            return &environment->entries.value[i].value;
-        }
+        environment = environment->enclosing;
+    }
+
+    Entry *entry = &environment->entries.value[slot];
+    return entry->cell != NULL ? &entry->cell->value : &entry->value;
+}
+
+void environment_define_at(Environment *environment, size_t slot, Literal value)
+{
+    Entry *entry = &environment->entries.value[slot];
+    if (entry->cell != NULL)
+    {
+        entry->cell->value = value;
+        return;
     }
 
-    if (environment->enclosing != NULL)
+    entry->value = value;
+}
+
+ObjectUpvalue *environment_capture(Environment *environment, size_t depth, size_t slot)
+{
+    for (size_t i = 0; i < depth; ++i)
+    {
+        environment = environment->enclosing;
+    }
+
+    // The cell is created on first capture. It is reachable from the frame
+    // as soon as it exists, so the caller may allocate again right away.
+    Entry *entry = &environment->entries.value[slot];
+    if (entry->cell == NULL)
     {
-        return environment_get(environment->enclosing, key);
+        entry->cell = object_new_upvalue(entry->value);
+        entry->value = literal_none();
     }
 
-    return NULL;
+    return entry->cell;
 }
 
-void environment_define(Environment *environment, char *key, Literal value)
+bool environment_is_captured(Environment *environment, size_t depth, size_t slot)
 {
-    environment->entries.count++;
-    environment->entries.value[environment->entries.count - 1].key = key;
-    environment->entries.value[environment->entries.count - 1].value = value;
+    for (size_t i = 0; i < depth; ++i)
+    {
+        environment = environment->enclosing;
+    }
+
+    return environment->entries.value[slot].cell != NULL;
 }
 
-void environment_assign(Environment *environment, char *key, Literal value)
+Environment environment_push(Environment *enclosing, size_t count)
 {
-    Literal *entry = environment_get(environment, key);
-    if (entry != NULL)
+    Environment environment = {
+        .enclosing = enclosing,
+        .entries = {
+            .count = count,
+            .value = NULL,
+        },
+    };
+
+    if (count == 0)
     {
-        *entry = value;
-        return;
+        return environment;
+    }
+
+    if (pool == NULL || pool->used + count > pool->capacity)
+    {
+        pool = environment_pool_next(count);
+    }
+
+    environment.entries.value = &pool->entries[pool->used];
+    pool->used += count;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        environment.entries.value[i] = (Entry){
+            .value = literal_none(),
+            .cell = NULL,
+        };
     }
 
-    if (environment->enclosing != NULL)
+    return environment;
+}
+
+void environment_pop(Environment *environment)
+{
+    if (environment->entries.count == 0)
     {
-        environment_assign(environment->enclosing, key, value);
         return;
     }
-}
\ No newline at end of file
+
+    pool->used -= environment->entries.count;
+    if (pool->used == 0 && pool->previous != NULL)
+    {
+        pool = pool->previous;
+    }
+}
+
+void environment_mark(void)
+{
+    for (EnvironmentPoolBlock *block = pool; block != NULL; block = block->previous)
+    {
+        for (size_t i = 0; i < block->used; ++i)
+        {
+            memory_mark_literal(block->entries[i].value);
+            memory_mark_object((Object *)block->entries[i].cell);
+        }
+    }
+}
+
+static EnvironmentPoolBlock *environment_pool_next(size_t count)
+{
+    EnvironmentPoolBlock *block = pool == NULL ? NULL : pool->next;
+    if (block != NULL && block->capacity < count)
+    {
+        // Blocks after the current one hold no live frames.
+        while (block != NULL)
+        {
+            EnvironmentPoolBlock *next = block->next;
+            free(block);
+            block = next;
+        }
+    }
+
+    if (block == NULL)
+    {
+        size_t capacity = count > ENVIRONMENT_POOL_BLOCK_SIZE ? count : ENVIRONMENT_POOL_BLOCK_SIZE;
+        block = malloc(sizeof(EnvironmentPoolBlock) + capacity * sizeof(Entry));
+        block->capacity = capacity;
+        block->next = NULL;
+        if (pool != NULL)
+        {
+            pool->next = block;
+        }
+    }
+
+    block->previous = pool;
+    block->used = 0;
+    return block;
+}
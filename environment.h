@@ -2,18 +2,22 @@
 #define ENVIRONMENT_H
 
 #include "token.h"
+#include "object.h"
 #include <stdlib.h>
 
 typedef struct Environment Environment;
 
+// Once a closure captures the slot, `cell` holds its value instead.
+typedef struct
+{
+    Literal value;
+    ObjectUpvalue *cell;
+} Entry;
+
 typedef struct
 {
     size_t count;
-    struct
-    {
-        char *key;
-        Literal value;
-    } value[256];
+    Entry *value;
 } Entries;
 
 struct Environment
@@ -22,8 +26,12 @@ struct Environment
     Environment *enclosing;
 };
 
-Literal *environment_get(Environment *environment, char *key);
-void environment_define(Environment *environment, char *key, Literal value);
-void environment_assign(Environment *environment, char *key, Literal value);
+Literal *environment_get_at(Environment *environment, size_t depth, size_t slot);
+void environment_define_at(Environment *environment, size_t slot, Literal value);
+ObjectUpvalue *environment_capture(Environment *environment, size_t depth, size_t slot);
+bool environment_is_captured(Environment *environment, size_t depth, size_t slot);
+Environment environment_push(Environment *enclosing, size_t count);
+void environment_pop(Environment *environment);
+void environment_mark(void);
 
-#endif
\ No newline at end of file
+#endif
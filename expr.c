@@ -1,54 +1,26 @@
 #include "expr.h"
+#include "object.h"
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 
-void expr_free(Expr *expr)
-{
-    if (expr == NULL)
-    {
-        return;
-    }
-
-    switch (expr->type)
-    {
-    case EXPR_TYPE_GROUPING:
-        expr_free(expr->as.grouping.expr);
-        break;
-    case EXPR_TYPE_UNARY:
-        expr_free(expr->as.unary.expr);
-        break;
-    case EXPR_TYPE_BINARY:
-        expr_free(expr->as.binary.left);
-        expr_free(expr->as.binary.right);
-        break;
-    case EXPR_TYPE_LOGICAL:
-        expr_free(expr->as.logical.left);
-        expr_free(expr->as.logical.right);
-        break;
-    default:
-        break;
-    }
-
-    free(expr);
-}
-
 void expr_print_string(Expr *expr)
 {
     switch (expr->type)
     {
     case EXPR_TYPE_LITERAL:
     {
-        switch (expr->as.literal.literal.type)
+        Literal literal = expr->as.literal.literal;
+        switch (literal_type(literal))
         {
         case LITERAL_STRING:
-            fprintf(stdout, "%s", expr->as.literal.literal.value.s);
+            fwrite(literal_string_chars(&literal), 1, literal_string_length(literal), stdout);
             break;
         case LITERAL_NUMBER:
-            fprintf(stdout, "%f", expr->as.literal.literal.value.i);
+            fprintf(stdout, "%f", literal_as_number(literal));
             break;
         case LITERAL_BOOL:
-            fprintf(stdout, "%s", expr->as.literal.literal.value.b ? "true" : "false");
+            fprintf(stdout, "%s", literal_as_bool(literal) ? "true" : "false");
             break;
         default:
             break;
@@ -59,12 +31,12 @@ void expr_print_string(Expr *expr)
         expr_print_string(expr->as.grouping.expr);
         break;
     case EXPR_TYPE_UNARY:
-        fprintf(stdout, "%s", token_type_get_name(&expr->as.unary.operator->type));
+        fprintf(stdout, "%s", token_type_get_name(expr->as.unary.operator->type));
         expr_print_string(expr->as.unary.expr);
         break;
     case EXPR_TYPE_BINARY:
         fprintf(stdout, "(");
-        fprintf(stdout, "%s ", token_type_get_name(&expr->as.binary.operator->type));
+        fprintf(stdout, "%s ", token_type_get_name(expr->as.binary.operator->type));
         expr_print_string(expr->as.binary.left);
         fprintf(stdout, " ");
         expr_print_string(expr->as.binary.right);
@@ -72,7 +44,7 @@ void expr_print_string(Expr *expr)
         break;
     case EXPR_TYPE_LOGICAL:
         fprintf(stdout, "(");
-        fprintf(stdout, "%s ", token_type_get_name(&expr->as.logical.operator->type));
+        fprintf(stdout, "%s ", token_type_get_name(expr->as.logical.operator->type));
         expr_print_string(expr->as.logical.left);
         fprintf(stdout, " ");
         expr_print_string(expr->as.logical.right);
@@ -3,8 +3,15 @@
 
 #include "token.h"
 
+#define EXPR_DEPTH_GLOBAL -1
+#define EXPR_DEPTH_UPVALUE -2
+
 typedef struct Expr Expr;
 
+// The tree walker's handler for a node, chosen once before the program
+// runs from the node's type and pre-decoded operands.
+typedef Literal (*ExprEvaluate)(Expr *expr);
+
 typedef struct
 {
     size_t count;
@@ -24,6 +31,23 @@ typedef enum
     EXPR_TYPE_ERROR
 } ExprType;
 
+typedef enum
+{
+    EXPR_OPERAND_NODE,
+    EXPR_OPERAND_CONSTANT,
+    EXPR_OPERAND_LOCAL
+} ExprOperandType;
+
+// An operand as the tree walker decodes it before the program runs: a
+// constant or a local slot is read in place, anything else is evaluated.
+typedef struct
+{
+    ExprOperandType type;
+    int depth;
+    int slot;
+    Literal constant;
+} ExprOperand;
+
 typedef struct
 {
     Literal literal;
@@ -32,12 +56,18 @@ typedef struct
 typedef struct
 {
     Token *name;
+    int depth;
+    int slot;
 } ExprVariable;
 
 typedef struct
 {
     Token *name;
     Expr *value;
+    int depth;
+    int slot;
+    // The right operand of `x = x + step` and `x = x - step`.
+    ExprOperand step;
 } ExprAssign;
 
 typedef struct
@@ -56,6 +86,8 @@ typedef struct
     Expr *left;
     Token *operator;
     Expr *right;
+    ExprOperand left_operand;
+    ExprOperand right_operand;
 } ExprBinary;
 
 typedef struct
@@ -79,6 +111,7 @@ typedef struct
 
 struct Expr
 {
+    ExprEvaluate evaluate;
     ExprType type;
     union
     {
@@ -94,7 +127,6 @@ struct Expr
     } as;
 };
 
-void expr_free(Expr *expr);
 void expr_print_string(Expr *expr);
 
 #endif
\ No newline at end of file
@@ -1,171 +1,626 @@
 #include "interpreter.h"
+#include <pthread.h>
+#include <sys/resource.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include "environment.h"
+#include "table.h"
 #include "lox_function.h"
+#include "memory.h"
+#include "object.h"
 
+// Lox calls recurse on the C stack, so programs run on a thread whose stack
+// is sized for the maximum call depth. Untouched pages are never committed,
+// so a generous reservation costs nothing for shallow programs.
+//
+// A call nests several visitor frames, about 0.9 KB for a plain recursive
+// call and 1.7 KB inside a nested expression (-O0); 4096 bytes per call
+// leaves headroom, and the stack guard catches anything deeper. The
+// reservation is capped so a large --max-depth does not ask for gigabytes
+// of address space; past the cap the guard bounds recursion instead.
+#define INTERPRETER_STACK_BYTES_PER_CALL 4096
+#define INTERPRETER_STACK_RESERVE (1024 * 1024)
+#define INTERPRETER_STACK_MAX (1024 * 1024 * 1024)
+#define INTERPRETER_STACK_FALLBACK (8 * 1024 * 1024)
+
+// How a loop body uses the counter of a counted loop, in increasing order.
+typedef enum
+{
+    INTERPRETER_USE_NONE,
+    INTERPRETER_USE_READ,
+    INTERPRETER_USE_WRITE
+} InterpreterUse;
+
+static void *interpreter_run(void *argument);
+static void interpreter_prepare_statements(Statements *statements);
+static void interpreter_prepare_stmt(Stmt *stmt);
+static void interpreter_prepare_expr(Expr *expr);
+static ExprOperand interpreter_decode_operand(Expr *expr);
+static ExprEvaluate interpreter_binary_handler(ExprBinary *binary);
+static ExprEvaluate interpreter_operator_handler(enum TokenType type);
+static ExprEvaluate interpreter_compare_handler(ExprBinary *binary);
+static ExprEvaluate interpreter_assign_handler(ExprAssign *assign);
+static StmtExecute interpreter_while_handler(StmtWhile *loop);
+static bool interpreter_is_counted_loop(StmtWhile *loop);
+static InterpreterUse interpreter_stmt_use(Stmt *stmt, int depth, int slot);
+static InterpreterUse interpreter_statements_use(Statements *statements, int depth, int slot);
+static InterpreterUse interpreter_expr_use(Expr *expr, int depth, int slot);
+static InterpreterUse interpreter_either_use(InterpreterUse first, InterpreterUse second);
+static bool interpreter_counted_test(enum TokenType type, double value, double bound);
 static InterpreterResult interpreter_execute(Stmt *stmt);
 static Literal interpreter_evaluate(Expr *expr);
-static bool interpreter_is_truthy(Literal literal);
-static bool interpreter_is_equal(Literal left, Literal right);
-static InterpreterResult interpreter_visit_block_stmt(StmtBlock *stmt);
-static InterpreterResult interpreter_visit_function_stmt(StmtFunction *stmt);
-static InterpreterResult interpreter_visit_return_stmt(StmtReturn *stmt);
-static InterpreterResult interpreter_visit_expression_stmt(StmtExpr *stmt);
-static InterpreterResult interpreter_visit_if_stmt(StmtIf *stmt);
-static InterpreterResult interpreter_visit_print_stmt(StmtPrint *stmt);
-static InterpreterResult interpreter_visit_while_stmt(StmtWhile *stmt);
-static InterpreterResult interpreter_visit_var_stmt(StmtVar *stmt);
-static Literal interpreter_visit_literal_expr(ExprLiteral *expr);
-static Literal interpreter_visit_assign_expr(ExprAssign *expr);
-static Literal interpreter_visit_var_expr(ExprVariable *expr);
-static Literal interpreter_visit_grouping_expr(ExprGrouping *expr);
-static Literal interpreter_visit_unary_expr(ExprUnary *expr);
-static Literal interpreter_visit_binary_expr(ExprBinary *expr);
-static Literal interpreter_visit_logical_expr(ExprLogical *expr);
-static Literal interpreter_visit_call_expr(ExprCall *expr);
-
-static Environment environment = (Environment){
-    .enclosing = NULL,
-    .entries = {
-        .count = 0,
-        .value = {},
-    },
+static InterpreterResult interpreter_visit_block_stmt(Stmt *stmt);
+static InterpreterResult interpreter_visit_function_stmt(Stmt *stmt);
+static InterpreterResult interpreter_visit_return_stmt(Stmt *stmt);
+static InterpreterResult interpreter_visit_tail_return_stmt(Stmt *stmt);
+static InterpreterResult interpreter_visit_expression_stmt(Stmt *stmt);
+static InterpreterResult interpreter_visit_if_stmt(Stmt *stmt);
+static InterpreterResult interpreter_visit_print_stmt(Stmt *stmt);
+static InterpreterResult interpreter_visit_while_stmt(Stmt *stmt);
+static InterpreterResult interpreter_visit_counted_loop_stmt(Stmt *stmt);
+static InterpreterResult interpreter_visit_counted_repeat_stmt(Stmt *stmt);
+static InterpreterResult interpreter_counted_loop(Stmt *stmt, bool sync);
+static InterpreterResult interpreter_visit_var_stmt(Stmt *stmt);
+static InterpreterResult interpreter_visit_none_stmt(Stmt *stmt);
+static Literal interpreter_visit_literal_expr(Expr *expr);
+static Literal interpreter_visit_assign_expr(Expr *expr);
+static Literal interpreter_visit_assign_local_expr(Expr *expr);
+static Literal interpreter_visit_increment_local_expr(Expr *expr);
+static Literal interpreter_visit_add_local_expr(Expr *expr);
+static Literal interpreter_visit_var_expr(Expr *expr);
+static Literal interpreter_visit_local_expr(Expr *expr);
+static Literal interpreter_visit_upvalue_expr(Expr *expr);
+static Literal interpreter_visit_grouping_expr(Expr *expr);
+static Literal interpreter_visit_negate_expr(Expr *expr);
+static Literal interpreter_visit_not_expr(Expr *expr);
+static Literal interpreter_visit_greater_expr(Expr *expr);
+static Literal interpreter_visit_greater_equal_expr(Expr *expr);
+static Literal interpreter_visit_less_expr(Expr *expr);
+static Literal interpreter_visit_less_equal_expr(Expr *expr);
+static Literal interpreter_visit_greater_constant_expr(Expr *expr);
+static Literal interpreter_visit_greater_equal_constant_expr(Expr *expr);
+static Literal interpreter_visit_less_constant_expr(Expr *expr);
+static Literal interpreter_visit_less_equal_constant_expr(Expr *expr);
+static Literal interpreter_visit_greater_locals_expr(Expr *expr);
+static Literal interpreter_visit_greater_equal_locals_expr(Expr *expr);
+static Literal interpreter_visit_less_locals_expr(Expr *expr);
+static Literal interpreter_visit_less_equal_locals_expr(Expr *expr);
+static Literal interpreter_unfuse_compare(Expr *expr);
+static Literal interpreter_visit_subtract_expr(Expr *expr);
+static Literal interpreter_visit_add_expr(Expr *expr);
+static Literal interpreter_visit_add_numbers_expr(Expr *expr);
+static Literal interpreter_visit_add_strings_expr(Expr *expr);
+static Literal interpreter_visit_add_generic_expr(Expr *expr);
+static Literal interpreter_visit_divide_expr(Expr *expr);
+static Literal interpreter_visit_multiply_expr(Expr *expr);
+static Literal interpreter_visit_not_equal_expr(Expr *expr);
+static Literal interpreter_visit_not_equal_numbers_expr(Expr *expr);
+static Literal interpreter_visit_not_equal_generic_expr(Expr *expr);
+static Literal interpreter_visit_equal_expr(Expr *expr);
+static Literal interpreter_visit_equal_numbers_expr(Expr *expr);
+static Literal interpreter_visit_equal_generic_expr(Expr *expr);
+static Literal interpreter_visit_and_expr(Expr *expr);
+static Literal interpreter_visit_or_expr(Expr *expr);
+static Literal interpreter_visit_call_expr(Expr *expr);
+static Literal interpreter_visit_none_expr(Expr *expr);
+static Literal interpreter_operand(Expr *expr, ExprOperand *operand);
+static Literal interpreter_right_operand(Expr *expr, Literal left);
+static Literal interpreter_rooted_evaluate(Expr *expr, Literal root);
+static Literal interpreter_add(Literal left, Literal right);
+static ObjectClosure *interpreter_callee(Literal callee, size_t arguments_count);
+static Literal *interpreter_lookup(Token *name, int depth, int slot);
+static bool interpreter_is_local(Expr *expr);
+static Literal interpreter_local(ExprOperand *operand);
+static ObjectClosure *interpreter_closure(StmtFunction *stmt);
+static Literal interpreter_concatenate(Literal left, Literal right);
+static void interpreter_push(Literal literal);
+static void interpreter_mark_roots(void);
+
+static Table globals = (Table){
+    .count = 0,
+    .capacity = 0,
+    .entries = NULL,
 };
-static Environment *environment_ptr = &environment;
+static Environment *environment_ptr = NULL;
+// The closure whose body is running; NULL at the top level.
+static ObjectClosure *closure = NULL;
 
-void intepreter_init(Interpreter *interpreter)
+static size_t call_depth = 0;
+static size_t max_depth = 0;
+// Calls fail cleanly once the C stack grows past this address, whatever
+// the depth, e.g. when a call sits under deeply nested expressions.
+static size_t stack_size = 0;
+static uintptr_t stack_limit = 0;
+
+// Temporaries that are live while a subexpression runs (left operands of
+// binary expressions, callees) are kept here so the collector can see them.
+static Literals stack = (Literals){
+    .count = 0,
+    .value = NULL,
+};
+static size_t stack_capacity = 0;
+
+void intepreter_interpret(Interpreter *interpreter)
 {
-    interpreter->environment_ptr = environment_ptr;
+    memory_set_roots(interpreter_mark_roots);
+    call_depth = 0;
+    max_depth = interpreter->max_depth;
+    interpreter_prepare_statements(&interpreter->statements);
+
+    stack_size = INTERPRETER_STACK_RESERVE + max_depth * INTERPRETER_STACK_BYTES_PER_CALL;
+    if (stack_size > INTERPRETER_STACK_MAX)
+    {
+        stack_size = INTERPRETER_STACK_MAX;
+    }
+
+    pthread_attr_t attributes;
+    pthread_t thread;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, stack_size);
+    if (pthread_create(&thread, &attributes, interpreter_run, interpreter) == 0)
+    {
+        pthread_join(thread, NULL);
+    }
+    else
+    {
+        // Fall back to the caller's stack and bound calls by its real size.
+        struct rlimit limit;
+        bool is_limited = getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY;
+        stack_size = is_limited ? (size_t)limit.rlim_cur : INTERPRETER_STACK_FALLBACK;
+        interpreter_run(interpreter);
+    }
+    pthread_attr_destroy(&attributes);
 }
 
-void intepreter_interpret(Interpreter *interpreter)
+static void *interpreter_run(void *argument)
 {
+    Interpreter *interpreter = argument;
+
+    char top;
+    size_t margin = stack_size / 2 < INTERPRETER_STACK_RESERVE / 2 ? stack_size / 2 : INTERPRETER_STACK_RESERVE / 2;
+    stack_limit = stack_size < (uintptr_t)&top ? (uintptr_t)&top - stack_size + margin : 0;
+
     for (size_t i = 0; i < interpreter->statements.count; ++i)
     {
         Stmt *stmt = interpreter->statements.value[i];
         interpreter_execute(stmt);
     }
+    return NULL;
 }
 
-static InterpreterResult interpreter_execute(Stmt *stmt)
+// Every node gets the handler for its exact shape once, up front: binary
+// expressions by operator, variables by where they live. Running a node is
+// then a single indirect call with no further decoding.
+static void interpreter_prepare_statements(Statements *statements)
+{
+    for (size_t i = 0; i < statements->count; ++i)
+    {
+        interpreter_prepare_stmt(statements->value[i]);
+    }
+}
+
+static void interpreter_prepare_stmt(Stmt *stmt)
 {
     switch (stmt->type)
     {
     case STMT_TYPE_FUNCTION:
-        return interpreter_visit_function_stmt(&stmt->as.function);
+        stmt->execute = interpreter_visit_function_stmt;
+        interpreter_prepare_statements(&stmt->as.function.body);
+        break;
     case STMT_TYPE_BLOCK:
-        return interpreter_visit_block_stmt(&stmt->as.block);
+        stmt->execute = interpreter_visit_block_stmt;
+        interpreter_prepare_statements(&stmt->as.block.statements);
+        break;
     case STMT_TYPE_EXPRESSION:
-        return interpreter_visit_expression_stmt(&stmt->as.expr);
+        stmt->execute = interpreter_visit_expression_stmt;
+        interpreter_prepare_expr(stmt->as.expr.expr);
+        break;
     case STMT_TYPE_IF:
-        return interpreter_visit_if_stmt(&stmt->as.iff);
+        stmt->execute = interpreter_visit_if_stmt;
+        interpreter_prepare_expr(stmt->as.iff.condition);
+        interpreter_prepare_stmt(stmt->as.iff.then_branch);
+        if (stmt->as.iff.else_branch != NULL)
+        {
+            interpreter_prepare_stmt(stmt->as.iff.else_branch);
+        }
+        break;
     case STMT_TYPE_PRINT:
-        return interpreter_visit_print_stmt(&stmt->as.print);
+        stmt->execute = interpreter_visit_print_stmt;
+        interpreter_prepare_expr(stmt->as.print.value);
+        break;
     case STMT_TYPE_WHILE:
-        return interpreter_visit_while_stmt(&stmt->as.whilee);
+        interpreter_prepare_expr(stmt->as.whilee.condition);
+        interpreter_prepare_stmt(stmt->as.whilee.body);
+        if (stmt->as.whilee.increment != NULL)
+        {
+            interpreter_prepare_expr(stmt->as.whilee.increment);
+        }
+        stmt->execute = interpreter_while_handler(&stmt->as.whilee);
+        break;
     case STMT_TYPE_VAR:
-        return interpreter_visit_var_stmt(&stmt->as.var);
+        stmt->execute = interpreter_visit_var_stmt;
+        if (stmt->as.var.initializer != NULL)
+        {
+            interpreter_prepare_expr(stmt->as.var.initializer);
+        }
+        break;
     case STMT_TYPE_RETURN:
-        return interpreter_visit_return_stmt(&stmt->as.returnn);
+        stmt->execute = stmt->as.returnn.tail ? interpreter_visit_tail_return_stmt : interpreter_visit_return_stmt;
+        if (stmt->as.returnn.value != NULL)
+        {
+            interpreter_prepare_expr(stmt->as.returnn.value);
+        }
+        break;
     default:
+        stmt->execute = interpreter_visit_none_stmt;
         break;
     }
-
-    return (InterpreterResult){
-        .type = INTERPRETER_RESULT_TYPE_NONE,
-        .value = {
-            .type = LITERAL_NONE,
-            .value.s = NULL,
-        },
-    };
 }
 
-static Literal interpreter_evaluate(Expr *expr)
+static void interpreter_prepare_expr(Expr *expr)
 {
     switch (expr->type)
     {
     case EXPR_TYPE_LITERAL:
-        return interpreter_visit_literal_expr(&expr->as.literal);
+        expr->evaluate = interpreter_visit_literal_expr;
+        break;
     case EXPR_TYPE_GROUPING:
-        return interpreter_visit_grouping_expr(&expr->as.grouping);
+        expr->evaluate = interpreter_visit_grouping_expr;
+        interpreter_prepare_expr(expr->as.grouping.expr);
+        break;
     case EXPR_TYPE_UNARY:
-        return interpreter_visit_unary_expr(&expr->as.unary);
+        switch (expr->as.unary.operator->type)
+        {
+        case TOKEN_TYPE_BANG:
+            expr->evaluate = interpreter_visit_not_expr;
+            break;
+        case TOKEN_TYPE_MINUS:
+            expr->evaluate = interpreter_visit_negate_expr;
+            break;
+        default:
+            expr->evaluate = interpreter_visit_none_expr;
+            break;
+        }
+        interpreter_prepare_expr(expr->as.unary.expr);
+        break;
     case EXPR_TYPE_BINARY:
-        return interpreter_visit_binary_expr(&expr->as.binary);
+        expr->as.binary.left_operand = interpreter_decode_operand(expr->as.binary.left);
+        expr->as.binary.right_operand = interpreter_decode_operand(expr->as.binary.right);
+        expr->evaluate = interpreter_binary_handler(&expr->as.binary);
+        interpreter_prepare_expr(expr->as.binary.left);
+        interpreter_prepare_expr(expr->as.binary.right);
+        break;
     case EXPR_TYPE_LOGICAL:
-        return interpreter_visit_logical_expr(&expr->as.logical);
+        expr->evaluate = expr->as.logical.operator->type == TOKEN_TYPE_OR ? interpreter_visit_or_expr : interpreter_visit_and_expr;
+        interpreter_prepare_expr(expr->as.logical.left);
+        interpreter_prepare_expr(expr->as.logical.right);
+        break;
     case EXPR_TYPE_ASSIGN:
-        return interpreter_visit_assign_expr(&expr->as.assign);
+        interpreter_prepare_expr(expr->as.assign.value);
+        expr->evaluate = interpreter_assign_handler(&expr->as.assign);
+        break;
     case EXPR_TYPE_VARIABLE:
-        return interpreter_visit_var_expr(&expr->as.variable);
+        if (expr->as.variable.depth == 0)
+        {
+            expr->evaluate = interpreter_visit_local_expr;
+        }
+        else if (expr->as.variable.depth == EXPR_DEPTH_UPVALUE)
+        {
+            expr->evaluate = interpreter_visit_upvalue_expr;
+        }
+        else
+        {
+            expr->evaluate = interpreter_visit_var_expr;
+        }
+        break;
     case EXPR_TYPE_CALL:
-        return interpreter_visit_call_expr(&expr->as.call);
+        expr->evaluate = interpreter_visit_call_expr;
+        interpreter_prepare_expr(expr->as.call.callee);
+        for (size_t i = 0; i < expr->as.call.arguments.count; ++i)
+        {
+            interpreter_prepare_expr(expr->as.call.arguments.value[i]);
+        }
+        break;
     default:
+        expr->evaluate = interpreter_visit_none_expr;
         break;
     }
+}
+
+static ExprOperand interpreter_decode_operand(Expr *expr)
+{
+    if (expr->type == EXPR_TYPE_LITERAL)
+    {
+        return (ExprOperand){
+            .type = EXPR_OPERAND_CONSTANT,
+            .constant = expr->as.literal.literal,
+        };
+    }
 
-    return (Literal){
-        .type = LITERAL_NONE,
-        .value.s = NULL,
+    if (interpreter_is_local(expr))
+    {
+        return (ExprOperand){
+            .type = EXPR_OPERAND_LOCAL,
+            .depth = expr->as.variable.depth,
+            .slot = expr->as.variable.slot,
+        };
+    }
+
+    return (ExprOperand){
+        .type = EXPR_OPERAND_NODE,
     };
 }
 
-static bool interpreter_is_truthy(Literal literal)
+static ExprEvaluate interpreter_binary_handler(ExprBinary *binary)
 {
-    if (literal.type == LITERAL_NONE)
+    ExprEvaluate fused = interpreter_compare_handler(binary);
+    if (fused != NULL)
     {
-        return false;
+        return fused;
+    }
+
+    return interpreter_operator_handler(binary->operator->type);
+}
+
+static ExprEvaluate interpreter_operator_handler(enum TokenType type)
+{
+    switch (type)
+    {
+    case TOKEN_TYPE_GREATER:
+        return interpreter_visit_greater_expr;
+    case TOKEN_TYPE_GREATER_EQUAL:
+        return interpreter_visit_greater_equal_expr;
+    case TOKEN_TYPE_LESS:
+        return interpreter_visit_less_expr;
+    case TOKEN_TYPE_LESS_EQUAL:
+        return interpreter_visit_less_equal_expr;
+    case TOKEN_TYPE_MINUS:
+        return interpreter_visit_subtract_expr;
+    case TOKEN_TYPE_PLUS:
+        return interpreter_visit_add_expr;
+    case TOKEN_TYPE_SLASH:
+        return interpreter_visit_divide_expr;
+    case TOKEN_TYPE_STAR:
+        return interpreter_visit_multiply_expr;
+    case TOKEN_TYPE_BANG_EQUAL:
+        return interpreter_visit_not_equal_expr;
+    case TOKEN_TYPE_EQUAL_EQUAL:
+        return interpreter_visit_equal_expr;
+    default:
+        return interpreter_visit_none_expr;
+    }
+}
+
+// Loop conditions and counters mostly compare or bump locals. These shapes
+// get fused handlers that read the slots directly instead of walking the
+// operand nodes; the operand nodes are still prepared for the fallbacks.
+static ExprEvaluate interpreter_compare_handler(ExprBinary *binary)
+{
+    if (binary->left_operand.type != EXPR_OPERAND_LOCAL)
+    {
+        return NULL;
+    }
+
+    ExprOperand *right = &binary->right_operand;
+    bool constant = right->type == EXPR_OPERAND_CONSTANT && literal_is_number(right->constant);
+    if (!constant && right->type != EXPR_OPERAND_LOCAL)
+    {
+        return NULL;
+    }
+
+    switch (binary->operator->type)
+    {
+    case TOKEN_TYPE_GREATER:
+        return constant ? interpreter_visit_greater_constant_expr : interpreter_visit_greater_locals_expr;
+    case TOKEN_TYPE_GREATER_EQUAL:
+        return constant ? interpreter_visit_greater_equal_constant_expr : interpreter_visit_greater_equal_locals_expr;
+    case TOKEN_TYPE_LESS:
+        return constant ? interpreter_visit_less_constant_expr : interpreter_visit_less_locals_expr;
+    case TOKEN_TYPE_LESS_EQUAL:
+        return constant ? interpreter_visit_less_equal_constant_expr : interpreter_visit_less_equal_locals_expr;
+    default:
+        return NULL;
+    }
+}
+
+static ExprEvaluate interpreter_assign_handler(ExprAssign *assign)
+{
+    ExprEvaluate plain = assign->depth == 0 ? interpreter_visit_assign_local_expr : interpreter_visit_assign_expr;
+    Expr *value = assign->value;
+    if (assign->depth < 0 || value->type != EXPR_TYPE_BINARY)
+    {
+        return plain;
+    }
+
+    // The step is only decoded when the target is also the left operand.
+    ExprBinary *binary = &value->as.binary;
+    ExprOperand *left = &binary->left_operand;
+    if (left->type != EXPR_OPERAND_LOCAL || left->depth != assign->depth || left->slot != assign->slot)
+    {
+        return plain;
+    }
+
+    assign->step = binary->right_operand;
+    if (binary->operator->type != TOKEN_TYPE_PLUS)
+    {
+        return plain;
+    }
+
+    if (assign->step.type == EXPR_OPERAND_CONSTANT && literal_is_number(assign->step.constant))
+    {
+        return interpreter_visit_increment_local_expr;
     }
 
-    if (literal.type == LITERAL_BOOL)
+    if (assign->step.type == EXPR_OPERAND_LOCAL)
+    {
+        return interpreter_visit_add_local_expr;
+    }
+
+    return plain;
+}
+
+// A counted loop whose body never assigns or captures its counter keeps
+// the counter out of its slot; see interpreter_counted_loop.
+static StmtExecute interpreter_while_handler(StmtWhile *loop)
+{
+    if (!interpreter_is_counted_loop(loop))
     {
-        return literal.value.b;
+        return interpreter_visit_while_stmt;
     }
 
-    return true;
+    ExprAssign *counter = &loop->increment->as.assign;
+    switch (interpreter_stmt_use(loop->body, counter->depth, counter->slot))
+    {
+    case INTERPRETER_USE_NONE:
+        return interpreter_visit_counted_repeat_stmt;
+    case INTERPRETER_USE_READ:
+        return interpreter_visit_counted_loop_stmt;
+    default:
+        return interpreter_visit_while_stmt;
+    }
 }
 
-static bool interpreter_is_equal(Literal left, Literal right)
+// A `for` loop whose increment steps a local by a number constant and
+// whose condition compares that local with a number constant or another
+// local.
+static bool interpreter_is_counted_loop(StmtWhile *loop)
 {
-    if (left.type == LITERAL_NONE && right.type == LITERAL_NONE)
+    Expr *increment = loop->increment;
+    if (increment == NULL || increment->type != EXPR_TYPE_ASSIGN || increment->as.assign.depth < 0)
     {
-        return true;
+        return false;
     }
-    if (left.type == LITERAL_NONE)
+
+    ExprAssign *assign = &increment->as.assign;
+    if (assign->step.type != EXPR_OPERAND_CONSTANT || !literal_is_number(assign->step.constant))
     {
         return false;
     }
 
-    if (left.type == LITERAL_NUMBER && right.type == LITERAL_NUMBER)
+    enum TokenType operator = assign->value->as.binary.operator->type;
+    if (operator != TOKEN_TYPE_PLUS && operator != TOKEN_TYPE_MINUS)
     {
-        return left.value.i == right.value.i;
+        return false;
     }
 
-    if (left.type == LITERAL_BOOL && right.type == LITERAL_BOOL)
+    if (loop->condition->type != EXPR_TYPE_BINARY)
     {
-        return left.value.b == right.value.b;
+        return false;
     }
 
-    if (left.type == LITERAL_STRING && right.type == LITERAL_STRING)
+    ExprBinary *test = &loop->condition->as.binary;
+    if (interpreter_compare_handler(test) == NULL || test->left_operand.depth != assign->depth || test->left_operand.slot != assign->slot)
     {
-        return strcmp(left.value.s, right.value.s) == 0;
+        return false;
     }
 
-    return false;
+    ExprOperand *bound = &test->right_operand;
+    return bound->type == EXPR_OPERAND_CONSTANT || bound->depth != assign->depth || bound->slot != assign->slot;
 }
 
-static InterpreterResult interpreter_visit_block_stmt(StmtBlock *stmt)
+// Scopes are counted from the loop's own, one more for each nested block.
+// Declaring a function may capture the counter, so it counts as a write.
+static InterpreterUse interpreter_stmt_use(Stmt *stmt, int depth, int slot)
 {
-    Environment block_environment = {
-        .enclosing = environment_ptr,
-        .entries = {
-            .count = 0,
-            .value = {},
-        },
-    };
-    return interpreter_execute_block(&stmt->statements, &block_environment);
+    InterpreterUse use = INTERPRETER_USE_NONE;
+    switch (stmt->type)
+    {
+    case STMT_TYPE_BLOCK:
+        return interpreter_statements_use(&stmt->as.block.statements, depth + 1, slot);
+    case STMT_TYPE_EXPRESSION:
+        return interpreter_expr_use(stmt->as.expr.expr, depth, slot);
+    case STMT_TYPE_FUNCTION:
+        return INTERPRETER_USE_WRITE;
+    case STMT_TYPE_IF:
+        use = interpreter_either_use(interpreter_expr_use(stmt->as.iff.condition, depth, slot), interpreter_stmt_use(stmt->as.iff.then_branch, depth, slot));
+        if (stmt->as.iff.else_branch != NULL)
+        {
+            use = interpreter_either_use(use, interpreter_stmt_use(stmt->as.iff.else_branch, depth, slot));
+        }
+        return use;
+    case STMT_TYPE_PRINT:
+        return interpreter_expr_use(stmt->as.print.value, depth, slot);
+    case STMT_TYPE_RETURN:
+        return stmt->as.returnn.value != NULL ? interpreter_expr_use(stmt->as.returnn.value, depth, slot) : use;
+    case STMT_TYPE_VAR:
+        return stmt->as.var.initializer != NULL ? interpreter_expr_use(stmt->as.var.initializer, depth, slot) : use;
+    case STMT_TYPE_WHILE:
+        use = interpreter_either_use(interpreter_expr_use(stmt->as.whilee.condition, depth, slot), interpreter_stmt_use(stmt->as.whilee.body, depth, slot));
+        if (stmt->as.whilee.increment != NULL)
+        {
+            use = interpreter_either_use(use, interpreter_expr_use(stmt->as.whilee.increment, depth, slot));
+        }
+        return use;
+    default:
+        return use;
+    }
+}
+
+static InterpreterUse interpreter_statements_use(Statements *statements, int depth, int slot)
+{
+    InterpreterUse use = INTERPRETER_USE_NONE;
+    for (size_t i = 0; i < statements->count; ++i)
+    {
+        use = interpreter_either_use(use, interpreter_stmt_use(statements->value[i], depth, slot));
+    }
+    return use;
+}
+
+static InterpreterUse interpreter_expr_use(Expr *expr, int depth, int slot)
+{
+    InterpreterUse use = INTERPRETER_USE_NONE;
+    switch (expr->type)
+    {
+    case EXPR_TYPE_VARIABLE:
+        return expr->as.variable.depth == depth && expr->as.variable.slot == slot ? INTERPRETER_USE_READ : use;
+    case EXPR_TYPE_ASSIGN:
+        if (expr->as.assign.depth == depth && expr->as.assign.slot == slot)
+        {
+            return INTERPRETER_USE_WRITE;
+        }
+        return interpreter_expr_use(expr->as.assign.value, depth, slot);
+    case EXPR_TYPE_GROUPING:
+        return interpreter_expr_use(expr->as.grouping.expr, depth, slot);
+    case EXPR_TYPE_UNARY:
+        return interpreter_expr_use(expr->as.unary.expr, depth, slot);
+    case EXPR_TYPE_BINARY:
+        return interpreter_either_use(interpreter_expr_use(expr->as.binary.left, depth, slot), interpreter_expr_use(expr->as.binary.right, depth, slot));
+    case EXPR_TYPE_LOGICAL:
+        return interpreter_either_use(interpreter_expr_use(expr->as.logical.left, depth, slot), interpreter_expr_use(expr->as.logical.right, depth, slot));
+    case EXPR_TYPE_CALL:
+        use = interpreter_expr_use(expr->as.call.callee, depth, slot);
+        for (size_t i = 0; i < expr->as.call.arguments.count; ++i)
+        {
+            use = interpreter_either_use(use, interpreter_expr_use(expr->as.call.arguments.value[i], depth, slot));
+        }
+        return use;
+    default:
+        return use;
+    }
+}
+
+static InterpreterUse interpreter_either_use(InterpreterUse first, InterpreterUse second)
+{
+    return first > second ? first : second;
+}
+
+static InterpreterResult interpreter_execute(Stmt *stmt)
+{
+    return stmt->execute(stmt);
+}
+
+static Literal interpreter_evaluate(Expr *expr)
+{
+    return expr->evaluate(expr);
+}
+
+static InterpreterResult interpreter_visit_block_stmt(Stmt *stmt)
+{
+    Environment block_environment = environment_push(environment_ptr, stmt->as.block.slots_count);
+    InterpreterResult result = interpreter_execute_block(&stmt->as.block.statements, &block_environment);
+    environment_pop(&block_environment);
+    return result;
 }
 
 InterpreterResult interpreter_execute_block(Statements *statements, Environment *block_environment)
@@ -175,8 +630,9 @@ InterpreterResult interpreter_execute_block(Statements *statements, Environment
     for (size_t i = 0; i < statements->count; ++i)
     {
         InterpreterResult result = interpreter_execute(statements->value[i]);
-        if (result.type == INTERPRETER_RESULT_TYPE_RETURN)
+        if (result.type != INTERPRETER_RESULT_TYPE_NONE)
         {
+            environment_ptr = previous;
             return result;
         }
     }
@@ -184,336 +640,846 @@ InterpreterResult interpreter_execute_block(Statements *statements, Environment
 
     return (InterpreterResult){
         .type = INTERPRETER_RESULT_TYPE_NONE,
-        .value = {
-            .type = LITERAL_NONE,
-            .value.s = NULL,
-        },
+        .value = literal_none(),
     };
 }
 
-static InterpreterResult interpreter_visit_function_stmt(StmtFunction *stmt)
+static InterpreterResult interpreter_visit_function_stmt(Stmt *stmt)
 {
-    environment_define(
-        environment_ptr,
-        stmt->name->lexeme,
-        (Literal){
-            .type = LITERAL_FUNCTION,
-            .value.f = {
-                .f = lox_function_call,
-                .stmt = stmt,
-            },
-        });
+    StmtFunction *function_stmt = &stmt->as.function;
+    Literal function = literal_function(interpreter_closure(function_stmt));
+
+    if (function_stmt->slot >= 0)
+    {
+        environment_define_at(environment_ptr, function_stmt->slot, function);
+    }
+    else
+    {
+        table_set(&globals, function_stmt->name->name, function);
+    }
 
     return (InterpreterResult){
         .type = INTERPRETER_RESULT_TYPE_NONE,
-        .value = {
-            .type = LITERAL_NONE,
-            .value.s = NULL,
-        },
+        .value = literal_none(),
     };
 }
 
-static InterpreterResult interpreter_visit_return_stmt(StmtReturn *stmt)
+static InterpreterResult interpreter_visit_return_stmt(Stmt *stmt)
 {
-    if (stmt->value != NULL)
+    if (stmt->as.returnn.value != NULL)
     {
         return (InterpreterResult){
             .type = INTERPRETER_RESULT_TYPE_RETURN,
-            .value = interpreter_evaluate(stmt->value),
+            .value = interpreter_evaluate(stmt->as.returnn.value),
         };
     }
     return (InterpreterResult){
-        .type = INTERPRETER_RESULT_TYPE_NONE,
-        .value = {
-            .type = LITERAL_NONE,
-            .value.s = NULL,
-        },
+        .type = INTERPRETER_RESULT_TYPE_RETURN,
+        .value = literal_none(),
     };
 }
 
-static InterpreterResult interpreter_visit_expression_stmt(StmtExpr *stmt)
+static InterpreterResult interpreter_visit_tail_return_stmt(Stmt *stmt)
 {
-    interpreter_evaluate(stmt->expr);
+    // The callee and its arguments are left on the value stack and the
+    // call loop in interpreter_visit_call_expr runs it once this frame
+    // has been popped.
+    ExprCall *call = &stmt->as.returnn.value->as.call;
+    Literal callee = interpreter_evaluate(call->callee);
+    interpreter_callee(callee, call->arguments.count);
+    interpreter_push(callee);
+    for (size_t i = 0; i < call->arguments.count; ++i)
+    {
+        interpreter_push(interpreter_evaluate(call->arguments.value[i]));
+    }
 
     return (InterpreterResult){
-        .type = INTERPRETER_RESULT_TYPE_NONE,
-        .value = {
-            .type = LITERAL_NONE,
-            .value.s = NULL,
-        },
+        .type = INTERPRETER_RESULT_TYPE_TAIL_CALL,
+        .value = callee,
     };
 }
 
-static InterpreterResult interpreter_visit_if_stmt(StmtIf *stmt)
+static InterpreterResult interpreter_visit_expression_stmt(Stmt *stmt)
 {
-    if (interpreter_is_truthy(interpreter_evaluate(stmt->condition)))
-    {
-        interpreter_execute(stmt->then_branch);
-    }
-    else if (stmt->else_branch != NULL)
-    {
-        interpreter_execute(stmt->else_branch);
-    }
+    interpreter_evaluate(stmt->as.expr.expr);
 
     return (InterpreterResult){
         .type = INTERPRETER_RESULT_TYPE_NONE,
-        .value = {
-            .type = LITERAL_NONE,
-            .value.s = NULL,
-        },
+        .value = literal_none(),
     };
 }
 
-static InterpreterResult interpreter_visit_print_stmt(StmtPrint *stmt)
+static InterpreterResult interpreter_visit_if_stmt(Stmt *stmt)
 {
-    Literal literal = interpreter_evaluate(stmt->value);
-    switch (literal.type)
+    if (literal_is_truthy(interpreter_evaluate(stmt->as.iff.condition)))
     {
-    case LITERAL_STRING:
-        fprintf(stdout, "%s\n", literal.value.s);
-        break;
-    case LITERAL_NUMBER:
-        fprintf(stdout, "%f\n", literal.value.i);
-        break;
-    case LITERAL_BOOL:
-        fprintf(stdout, "%s\n", literal.value.b ? "true" : "false");
-        break;
-    default:
-        break;
+        return interpreter_execute(stmt->as.iff.then_branch);
+    }
+    else if (stmt->as.iff.else_branch != NULL)
+    {
+        return interpreter_execute(stmt->as.iff.else_branch);
     }
 
     return (InterpreterResult){
         .type = INTERPRETER_RESULT_TYPE_NONE,
-        .value = {
-            .type = LITERAL_NONE,
-            .value.s = NULL,
-        },
+        .value = literal_none(),
     };
 }
 
-static InterpreterResult interpreter_visit_while_stmt(StmtWhile *stmt)
+static InterpreterResult interpreter_visit_print_stmt(Stmt *stmt)
 {
-    while (interpreter_is_truthy(interpreter_evaluate(stmt->condition)))
-    {
-        InterpreterResult result = interpreter_execute(stmt->body);
-        if (result.type == INTERPRETER_RESULT_TYPE_RETURN)
-        {
-            return result;
-        }
-    }
+    literal_print(interpreter_evaluate(stmt->as.print.value));
 
     return (InterpreterResult){
         .type = INTERPRETER_RESULT_TYPE_NONE,
-        .value = {
-            .type = LITERAL_NONE,
-            .value.s = NULL,
-        },
+        .value = literal_none(),
     };
 }
 
-static InterpreterResult interpreter_visit_var_stmt(StmtVar *stmt)
+static InterpreterResult interpreter_visit_while_stmt(Stmt *stmt)
 {
-    if (stmt->initializer != NULL)
+    while (literal_is_truthy(interpreter_evaluate(stmt->as.whilee.condition)))
     {
-        Literal value = interpreter_evaluate(stmt->initializer);
-        environment_define(environment_ptr, stmt->name->lexeme, value);
+        InterpreterResult result = interpreter_execute(stmt->as.whilee.body);
+        if (result.type != INTERPRETER_RESULT_TYPE_NONE)
+        {
+            return result;
+        }
+
+        if (stmt->as.whilee.increment != NULL)
+        {
+            interpreter_evaluate(stmt->as.whilee.increment);
+        }
     }
 
     return (InterpreterResult){
         .type = INTERPRETER_RESULT_TYPE_NONE,
-        .value = {
-            .type = LITERAL_NONE,
-            .value.s = NULL,
-        },
+        .value = literal_none(),
     };
 }
 
-static Literal interpreter_visit_literal_expr(ExprLiteral *expr)
+static InterpreterResult interpreter_visit_counted_loop_stmt(Stmt *stmt)
 {
-    return expr->literal;
+    return interpreter_counted_loop(stmt, true);
 }
 
-static Literal interpreter_visit_assign_expr(ExprAssign *expr)
+static InterpreterResult interpreter_visit_counted_repeat_stmt(Stmt *stmt)
 {
-    Literal value = interpreter_evaluate(expr->value);
-    environment_assign(environment_ptr, expr->name->lexeme, value);
-    return value;
+    return interpreter_counted_loop(stmt, false);
 }
 
-static Literal interpreter_visit_var_expr(ExprVariable *expr)
+// The counter is kept in a C double and tested and stepped with no
+// condition or increment nodes and no truthiness check. The body cannot
+// assign it, so its slot is only written: before each pass when `sync`
+// says the body reads it, and when the loop ends. A counter that is not a
+// number or was captured before the loop, or a bound that is not a
+// number, leaves the rest to the general loop.
+static InterpreterResult interpreter_counted_loop(Stmt *stmt, bool sync)
 {
-    return *environment_get(environment_ptr, expr->name->lexeme);
-}
+    StmtWhile *loop = &stmt->as.whilee;
+    ExprBinary *test = &loop->condition->as.binary;
+    ExprAssign *increment = &loop->increment->as.assign;
 
-static Literal interpreter_visit_grouping_expr(ExprGrouping *expr)
-{
-    return interpreter_evaluate(expr->expr);
-}
+    double step = literal_as_number(increment->step.constant);
+    if (increment->value->as.binary.operator->type == TOKEN_TYPE_MINUS)
+    {
+        step = -step;
+    }
 
-static Literal interpreter_visit_unary_expr(ExprUnary *expr)
-{
-    Literal right = interpreter_evaluate(expr->expr);
+    bool constant = test->right_operand.type == EXPR_OPERAND_CONSTANT;
+    double bound = constant ? literal_as_number(test->right_operand.constant) : 0;
 
-    switch (expr->operator->type)
+    if (environment_is_captured(environment_ptr, increment->depth, increment->slot))
     {
-    case TOKEN_TYPE_BANG:
-    {
-        Literal b_literal = right;
-        b_literal.value.b = !interpreter_is_truthy(b_literal);
-        return b_literal;
+        return interpreter_visit_while_stmt(stmt);
     }
-    case TOKEN_TYPE_MINUS:
+
+    Literal *counter = environment_get_at(environment_ptr, increment->depth, increment->slot);
+    if (!literal_is_number(*counter))
     {
-        Literal m_literal = right;
-        m_literal.value.i = -m_literal.value.i;
-        return m_literal;
-    }
-    default:
-        break;
+        return interpreter_visit_while_stmt(stmt);
     }
 
-    return (Literal){
-        .type = LITERAL_NONE,
-        .value.s = NULL,
+    double value = literal_as_number(*counter);
+    InterpreterResult result = (InterpreterResult){
+        .type = INTERPRETER_RESULT_TYPE_NONE,
+        .value = literal_none(),
     };
+    for (;;)
+    {
+        if (!constant)
+        {
+            Literal limit = interpreter_local(&test->right_operand);
+            if (!literal_is_number(limit))
+            {
+                *counter = literal_number(value);
+                return interpreter_visit_while_stmt(stmt);
+            }
+            bound = literal_as_number(limit);
+        }
+
+        if (!interpreter_counted_test(test->operator->type, value, bound))
+        {
+            break;
+        }
+
+        if (sync)
+        {
+            *counter = literal_number(value);
+        }
+
+        result = interpreter_execute(loop->body);
+        if (result.type != INTERPRETER_RESULT_TYPE_NONE)
+        {
+            break;
+        }
+
+        value += step;
+    }
+
+    *counter = literal_number(value);
+    return result;
 }
 
-static Literal interpreter_visit_binary_expr(ExprBinary *expr)
+static bool interpreter_counted_test(enum TokenType type, double value, double bound)
 {
-    Literal left = interpreter_evaluate(expr->left);
-    Literal right = interpreter_evaluate(expr->right);
-
-    switch (expr->operator->type)
+    switch (type)
     {
     case TOKEN_TYPE_GREATER:
-        return (Literal){
-            .type = LITERAL_BOOL,
-            .value.b = left.value.i > right.value.i,
-        };
+        return value > bound;
     case TOKEN_TYPE_GREATER_EQUAL:
-        return (Literal){
-            .type = LITERAL_BOOL,
-            .value.b = left.value.i >= right.value.i,
-        };
-        break;
+        return value >= bound;
     case TOKEN_TYPE_LESS:
-        return (Literal){
-            .type = LITERAL_BOOL,
-            .value.b = left.value.i < right.value.i,
-        };
-        break;
-    case TOKEN_TYPE_LESS_EQUAL:
-        return (Literal){
-            .type = LITERAL_BOOL,
-            .value.b = left.value.i <= right.value.i,
-        };
-        break;
-    case TOKEN_TYPE_MINUS:
-        return (Literal){
-            .type = LITERAL_NUMBER,
-            .value.i = left.value.i - right.value.i,
-        };
-        break;
-    case TOKEN_TYPE_PLUS:
-        if (left.type == LITERAL_NUMBER && right.type == LITERAL_NUMBER)
+        return value < bound;
+    default:
+        return value <= bound;
+    }
+}
+
+static InterpreterResult interpreter_visit_var_stmt(Stmt *stmt)
+{
+    StmtVar *var = &stmt->as.var;
+    Literal value = literal_none();
+    if (var->initializer != NULL)
+    {
+        value = interpreter_evaluate(var->initializer);
+    }
+
+    if (var->slot >= 0)
+    {
+        environment_define_at(environment_ptr, var->slot, value);
+    }
+    else
+    {
+        table_set(&globals, var->name->name, value);
+    }
+
+    return (InterpreterResult){
+        .type = INTERPRETER_RESULT_TYPE_NONE,
+        .value = literal_none(),
+    };
+}
+
+static InterpreterResult interpreter_visit_none_stmt(Stmt *stmt)
+{
+    (void)stmt;
+    return (InterpreterResult){
+        .type = INTERPRETER_RESULT_TYPE_NONE,
+        .value = literal_none(),
+    };
+}
+
+static Literal interpreter_visit_literal_expr(Expr *expr)
+{
+    return expr->as.literal.literal;
+}
+
+static Literal interpreter_visit_assign_expr(Expr *expr)
+{
+    ExprAssign *assign = &expr->as.assign;
+    Literal value = interpreter_evaluate(assign->value);
+    *interpreter_lookup(assign->name, assign->depth, assign->slot) = value;
+    return value;
+}
+
+static Literal interpreter_visit_assign_local_expr(Expr *expr)
+{
+    Literal value = interpreter_evaluate(expr->as.assign.value);
+    environment_define_at(environment_ptr, expr->as.assign.slot, value);
+    return value;
+}
+
+// `x = x + k` and `x = x + y` on locals: one lookup per variable and one
+// store. Anything but numbers switches the node to the general assignment
+// for good.
+static Literal interpreter_visit_increment_local_expr(Expr *expr)
+{
+    ExprAssign *assign = &expr->as.assign;
+    Literal *target = environment_get_at(environment_ptr, assign->depth, assign->slot);
+    if (literal_is_number(*target))
+    {
+        *target = literal_number(literal_as_number(*target) + literal_as_number(assign->step.constant));
+        return *target;
+    }
+
+    expr->evaluate = interpreter_visit_assign_expr;
+    return interpreter_visit_assign_expr(expr);
+}
+
+static Literal interpreter_visit_add_local_expr(Expr *expr)
+{
+    ExprAssign *assign = &expr->as.assign;
+    Literal *target = environment_get_at(environment_ptr, assign->depth, assign->slot);
+    Literal value = *environment_get_at(environment_ptr, assign->step.depth, assign->step.slot);
+    if (literal_is_number(*target) && literal_is_number(value))
+    {
+        *target = literal_number(literal_as_number(*target) + literal_as_number(value));
+        return *target;
+    }
+
+    expr->evaluate = interpreter_visit_assign_expr;
+    return interpreter_visit_assign_expr(expr);
+}
+
+static Literal interpreter_visit_var_expr(Expr *expr)
+{
+    return *interpreter_lookup(expr->as.variable.name, expr->as.variable.depth, expr->as.variable.slot);
+}
+
+static Literal interpreter_visit_local_expr(Expr *expr)
+{
+    Entry *entry = &environment_ptr->entries.value[expr->as.variable.slot];
+    return entry->cell != NULL ? entry->cell->value : entry->value;
+}
+
+static Literal interpreter_visit_upvalue_expr(Expr *expr)
+{
+    return closure->upvalues[expr->as.variable.slot]->value;
+}
+
+static Literal *interpreter_lookup(Token *name, int depth, int slot)
+{
+    if (depth >= 0)
+    {
+        return environment_get_at(environment_ptr, depth, slot);
+    }
+
+    if (depth == EXPR_DEPTH_UPVALUE)
+    {
+        return &closure->upvalues[slot]->value;
+    }
+
+    Literal *value = table_get(&globals, name->name);
+    if (value == NULL)
+    {
+        fprintf(stderr, "Undefined variable '%s'.\n", name->name->chars);
+        exit(70);
+    }
+
+    return value;
+}
+
+static bool interpreter_is_local(Expr *expr)
+{
+    return expr->type == EXPR_TYPE_VARIABLE && expr->as.variable.depth >= 0;
+}
+
+static Literal interpreter_local(ExprOperand *operand)
+{
+    return *environment_get_at(environment_ptr, operand->depth, operand->slot);
+}
+
+static Literal interpreter_visit_grouping_expr(Expr *expr)
+{
+    return interpreter_evaluate(expr->as.grouping.expr);
+}
+
+static Literal interpreter_visit_negate_expr(Expr *expr)
+{
+    return literal_number(-literal_as_number(interpreter_evaluate(expr->as.unary.expr)));
+}
+
+static Literal interpreter_visit_not_expr(Expr *expr)
+{
+    return literal_bool(!literal_is_truthy(interpreter_evaluate(expr->as.unary.expr)));
+}
+
+// Constants and locals are read in place; only other operands run their
+// node.
+static Literal interpreter_operand(Expr *expr, ExprOperand *operand)
+{
+    if (operand->type == EXPR_OPERAND_CONSTANT)
+    {
+        return operand->constant;
+    }
+
+    if (operand->type == EXPR_OPERAND_LOCAL)
+    {
+        if (operand->depth == 0)
         {
-            return (Literal){
-                .type = LITERAL_NUMBER,
-                .value.i = left.value.i + right.value.i,
-            };
+            Entry *entry = &environment_ptr->entries.value[operand->slot];
+            return entry->cell != NULL ? entry->cell->value : entry->value;
         }
+        return *environment_get_at(environment_ptr, operand->depth, operand->slot);
+    }
+
+    return expr->evaluate(expr);
+}
+
+// The left operand stays on the value stack while the right one runs, in
+// case that allocates. Numbers need no rooting, and constants and variable
+// reads never allocate.
+static Literal interpreter_right_operand(Expr *expr, Literal left)
+{
+    Expr *right = expr->as.binary.right;
+    ExprOperand *operand = &expr->as.binary.right_operand;
+    if (operand->type != EXPR_OPERAND_NODE)
+    {
+        return interpreter_operand(right, operand);
+    }
+
+    if (literal_is_number(left) || right->type == EXPR_TYPE_VARIABLE)
+    {
+        return right->evaluate(right);
+    }
+
+    return interpreter_rooted_evaluate(right, left);
+}
+
+static Literal interpreter_rooted_evaluate(Expr *expr, Literal root)
+{
+    interpreter_push(root);
+    Literal result = interpreter_evaluate(expr);
+    stack.count--;
+    return result;
+}
+
+static Literal interpreter_visit_greater_expr(Expr *expr)
+{
+    Literal left = interpreter_operand(expr->as.binary.left, &expr->as.binary.left_operand);
+    Literal right = interpreter_right_operand(expr, left);
+    return literal_bool(literal_as_number(left) > literal_as_number(right));
+}
+
+static Literal interpreter_visit_greater_equal_expr(Expr *expr)
+{
+    Literal left = interpreter_operand(expr->as.binary.left, &expr->as.binary.left_operand);
+    Literal right = interpreter_right_operand(expr, left);
+    return literal_bool(literal_as_number(left) >= literal_as_number(right));
+}
+
+static Literal interpreter_visit_less_expr(Expr *expr)
+{
+    Literal left = interpreter_operand(expr->as.binary.left, &expr->as.binary.left_operand);
+    Literal right = interpreter_right_operand(expr, left);
+    return literal_bool(literal_as_number(left) < literal_as_number(right));
+}
+
+static Literal interpreter_visit_less_equal_expr(Expr *expr)
+{
+    Literal left = interpreter_operand(expr->as.binary.left, &expr->as.binary.left_operand);
+    Literal right = interpreter_right_operand(expr, left);
+    return literal_bool(literal_as_number(left) <= literal_as_number(right));
+}
+
+static Literal interpreter_visit_greater_constant_expr(Expr *expr)
+{
+    Literal left = interpreter_local(&expr->as.binary.left_operand);
+    if (!literal_is_number(left))
+    {
+        return interpreter_unfuse_compare(expr);
+    }
+
+    return literal_bool(literal_as_number(left) > literal_as_number(expr->as.binary.right_operand.constant));
+}
+
+static Literal interpreter_visit_greater_equal_constant_expr(Expr *expr)
+{
+    Literal left = interpreter_local(&expr->as.binary.left_operand);
+    if (!literal_is_number(left))
+    {
+        return interpreter_unfuse_compare(expr);
+    }
+
+    return literal_bool(literal_as_number(left) >= literal_as_number(expr->as.binary.right_operand.constant));
+}
+
+static Literal interpreter_visit_less_constant_expr(Expr *expr)
+{
+    Literal left = interpreter_local(&expr->as.binary.left_operand);
+    if (!literal_is_number(left))
+    {
+        return interpreter_unfuse_compare(expr);
+    }
+
+    return literal_bool(literal_as_number(left) < literal_as_number(expr->as.binary.right_operand.constant));
+}
+
+static Literal interpreter_visit_less_equal_constant_expr(Expr *expr)
+{
+    Literal left = interpreter_local(&expr->as.binary.left_operand);
+    if (!literal_is_number(left))
+    {
+        return interpreter_unfuse_compare(expr);
+    }
 
-        if (left.type == LITERAL_STRING && right.type == LITERAL_STRING)
+    return literal_bool(literal_as_number(left) <= literal_as_number(expr->as.binary.right_operand.constant));
+}
+
+static Literal interpreter_visit_greater_locals_expr(Expr *expr)
+{
+    Literal left = interpreter_local(&expr->as.binary.left_operand);
+    Literal right = interpreter_local(&expr->as.binary.right_operand);
+    if (!literal_is_number(left) || !literal_is_number(right))
+    {
+        return interpreter_unfuse_compare(expr);
+    }
+
+    return literal_bool(literal_as_number(left) > literal_as_number(right));
+}
+
+static Literal interpreter_visit_greater_equal_locals_expr(Expr *expr)
+{
+    Literal left = interpreter_local(&expr->as.binary.left_operand);
+    Literal right = interpreter_local(&expr->as.binary.right_operand);
+    if (!literal_is_number(left) || !literal_is_number(right))
+    {
+        return interpreter_unfuse_compare(expr);
+    }
+
+    return literal_bool(literal_as_number(left) >= literal_as_number(right));
+}
+
+static Literal interpreter_visit_less_locals_expr(Expr *expr)
+{
+    Literal left = interpreter_local(&expr->as.binary.left_operand);
+    Literal right = interpreter_local(&expr->as.binary.right_operand);
+    if (!literal_is_number(left) || !literal_is_number(right))
+    {
+        return interpreter_unfuse_compare(expr);
+    }
+
+    return literal_bool(literal_as_number(left) < literal_as_number(right));
+}
+
+static Literal interpreter_visit_less_equal_locals_expr(Expr *expr)
+{
+    Literal left = interpreter_local(&expr->as.binary.left_operand);
+    Literal right = interpreter_local(&expr->as.binary.right_operand);
+    if (!literal_is_number(left) || !literal_is_number(right))
+    {
+        return interpreter_unfuse_compare(expr);
+    }
+
+    return literal_bool(literal_as_number(left) <= literal_as_number(right));
+}
+
+// The slots of a fused compare held something other than a number: the
+// node runs the generic handler for its operator from now on.
+static Literal interpreter_unfuse_compare(Expr *expr)
+{
+    expr->evaluate = interpreter_operator_handler(expr->as.binary.operator->type);
+    return expr->evaluate(expr);
+}
+
+static Literal interpreter_visit_subtract_expr(Expr *expr)
+{
+    Literal left = interpreter_operand(expr->as.binary.left, &expr->as.binary.left_operand);
+    Literal right = interpreter_right_operand(expr, left);
+    return literal_number(literal_as_number(left) - literal_as_number(right));
+}
+
+// `+`, `==` and `!=` start out observing: the first run rewrites the node
+// into a variant for the operand types seen there. A variant guards on
+// those types and falls back to the generic handler for good once the
+// guard fails.
+static Literal interpreter_visit_add_expr(Expr *expr)
+{
+    Literal left = interpreter_operand(expr->as.binary.left, &expr->as.binary.left_operand);
+    Literal right = interpreter_right_operand(expr, left);
+    if (literal_is_number(left) && literal_is_number(right))
+    {
+        expr->evaluate = interpreter_visit_add_numbers_expr;
+    }
+    else if (literal_is_string(left) && literal_is_string(right))
+    {
+        expr->evaluate = interpreter_visit_add_strings_expr;
+    }
+    else
+    {
+        expr->evaluate = interpreter_visit_add_generic_expr;
+    }
+
+    return interpreter_add(left, right);
+}
+
+static Literal interpreter_visit_add_numbers_expr(Expr *expr)
+{
+    Literal left = interpreter_operand(expr->as.binary.left, &expr->as.binary.left_operand);
+    Literal right = interpreter_right_operand(expr, left);
+    if (literal_is_number(left) && literal_is_number(right))
+    {
+        return literal_number(literal_as_number(left) + literal_as_number(right));
+    }
+
+    expr->evaluate = interpreter_visit_add_generic_expr;
+    return interpreter_add(left, right);
+}
+
+static Literal interpreter_visit_add_strings_expr(Expr *expr)
+{
+    Literal left = interpreter_operand(expr->as.binary.left, &expr->as.binary.left_operand);
+    Literal right = interpreter_right_operand(expr, left);
+    if (literal_is_string(left) && literal_is_string(right))
+    {
+        return interpreter_concatenate(left, right);
+    }
+
+    expr->evaluate = interpreter_visit_add_generic_expr;
+    return interpreter_add(left, right);
+}
+
+static Literal interpreter_visit_add_generic_expr(Expr *expr)
+{
+    Literal left = interpreter_operand(expr->as.binary.left, &expr->as.binary.left_operand);
+    Literal right = interpreter_right_operand(expr, left);
+    return interpreter_add(left, right);
+}
+
+static Literal interpreter_add(Literal left, Literal right)
+{
+    if (literal_is_number(left) && literal_is_number(right))
+    {
+        return literal_number(literal_as_number(left) + literal_as_number(right));
+    }
+
+    if (literal_is_string(left) && literal_is_string(right))
+    {
+        return interpreter_concatenate(left, right);
+    }
+
+    return literal_none();
+}
+
+static Literal interpreter_visit_divide_expr(Expr *expr)
+{
+    Literal left = interpreter_operand(expr->as.binary.left, &expr->as.binary.left_operand);
+    Literal right = interpreter_right_operand(expr, left);
+    return literal_number(literal_as_number(left) / literal_as_number(right));
+}
+
+static Literal interpreter_visit_multiply_expr(Expr *expr)
+{
+    Literal left = interpreter_operand(expr->as.binary.left, &expr->as.binary.left_operand);
+    Literal right = interpreter_right_operand(expr, left);
+    return literal_number(literal_as_number(left) * literal_as_number(right));
+}
+
+static Literal interpreter_visit_not_equal_expr(Expr *expr)
+{
+    Literal left = interpreter_operand(expr->as.binary.left, &expr->as.binary.left_operand);
+    Literal right = interpreter_right_operand(expr, left);
+    bool numbers = literal_is_number(left) && literal_is_number(right);
+    expr->evaluate = numbers ? interpreter_visit_not_equal_numbers_expr : interpreter_visit_not_equal_generic_expr;
+    return literal_bool(!literal_is_equal(left, right));
+}
+
+static Literal interpreter_visit_not_equal_numbers_expr(Expr *expr)
+{
+    Literal left = interpreter_operand(expr->as.binary.left, &expr->as.binary.left_operand);
+    Literal right = interpreter_right_operand(expr, left);
+    if (literal_is_number(left) && literal_is_number(right))
+    {
+        return literal_bool(literal_as_number(left) != literal_as_number(right));
+    }
+
+    expr->evaluate = interpreter_visit_not_equal_generic_expr;
+    return literal_bool(!literal_is_equal(left, right));
+}
+
+static Literal interpreter_visit_not_equal_generic_expr(Expr *expr)
+{
+    Literal left = interpreter_operand(expr->as.binary.left, &expr->as.binary.left_operand);
+    Literal right = interpreter_right_operand(expr, left);
+    return literal_bool(!literal_is_equal(left, right));
+}
+
+static Literal interpreter_visit_equal_expr(Expr *expr)
+{
+    Literal left = interpreter_operand(expr->as.binary.left, &expr->as.binary.left_operand);
+    Literal right = interpreter_right_operand(expr, left);
+    bool numbers = literal_is_number(left) && literal_is_number(right);
+    expr->evaluate = numbers ? interpreter_visit_equal_numbers_expr : interpreter_visit_equal_generic_expr;
+    return literal_bool(literal_is_equal(left, right));
+}
+
+static Literal interpreter_visit_equal_numbers_expr(Expr *expr)
+{
+    Literal left = interpreter_operand(expr->as.binary.left, &expr->as.binary.left_operand);
+    Literal right = interpreter_right_operand(expr, left);
+    if (literal_is_number(left) && literal_is_number(right))
+    {
+        return literal_bool(literal_as_number(left) == literal_as_number(right));
+    }
+
+    expr->evaluate = interpreter_visit_equal_generic_expr;
+    return literal_bool(literal_is_equal(left, right));
+}
+
+static Literal interpreter_visit_equal_generic_expr(Expr *expr)
+{
+    Literal left = interpreter_operand(expr->as.binary.left, &expr->as.binary.left_operand);
+    Literal right = interpreter_right_operand(expr, left);
+    return literal_bool(literal_is_equal(left, right));
+}
+
+static Literal interpreter_visit_and_expr(Expr *expr)
+{
+    Literal left = interpreter_evaluate(expr->as.logical.left);
+    if (!literal_is_truthy(left))
+        return left;
+
+    return interpreter_evaluate(expr->as.logical.right);
+}
+
+static Literal interpreter_visit_or_expr(Expr *expr)
+{
+    Literal left = interpreter_evaluate(expr->as.logical.left);
+    if (literal_is_truthy(left))
+        return left;
+
+    return interpreter_evaluate(expr->as.logical.right);
+}
+
+static Literal interpreter_visit_call_expr(Expr *expr)
+{
+    ExprCall *call = &expr->as.call;
+    Literal callee = interpreter_evaluate(call->callee);
+    ObjectClosure *function = interpreter_callee(callee, call->arguments.count);
+
+    char marker;
+    if (call_depth == max_depth || (uintptr_t)&marker < stack_limit)
+    {
+        fprintf(stderr, "Stack overflow.\n");
+        exit(70);
+    }
+
+    // The callee stays on the value stack so the closure and its cells
+    // survive the call even if nothing else refers to them. Its frame is
+    // reserved up front and each argument is evaluated straight into its
+    // parameter slot; calls made while evaluating the arguments push their
+    // frames above it and are gone before it is entered.
+    interpreter_push(callee);
+    size_t callee_slot = stack.count - 1;
+    Environment environment = environment_push(NULL, function->function->slots_count);
+    for (size_t i = 0; i < call->arguments.count; ++i)
+    {
+        environment_define_at(&environment, i, interpreter_evaluate(call->arguments.value[i]));
+    }
+
+    ObjectClosure *previous = closure;
+    call_depth++;
+    InterpreterResult result;
+    for (;;)
+    {
+        closure = function;
+        result = lox_function_call(&environment, function->function);
+        if (result.type != INTERPRETER_RESULT_TYPE_TAIL_CALL)
         {
-            size_t len1 = strlen(left.value.s);
-            size_t len2 = strlen(right.value.s);
-            char *result = malloc(len1 + len2 + 1);
-            memcpy(result, left.value.s, len1);
-            memcpy(result + len1, right.value.s, len2 + 1);
-
-            return (Literal){
-                .type = LITERAL_STRING,
-                .value.s = result,
-                .is_owned = true,
-            };
+            break;
         }
-        break;
-    case TOKEN_TYPE_SLASH:
-        return (Literal){
-            .type = LITERAL_NUMBER,
-            .value.i = left.value.i / right.value.i,
-        };
-        break;
-    case TOKEN_TYPE_STAR:
-        return (Literal){
-            .type = LITERAL_NUMBER,
-            .value.i = left.value.i * right.value.i,
-        };
-        break;
-    case TOKEN_TYPE_BANG_EQUAL:
-        return (Literal){
-            .type = LITERAL_BOOL,
-            .value.b = !interpreter_is_equal(left, right),
-        };
-        break;
-    case TOKEN_TYPE_EQUAL_EQUAL:
-        return (Literal){
-            .type = LITERAL_BOOL,
-            .value.b = interpreter_is_equal(left, right),
-        };
-        break;
-    default:
-        break;
+
+        // A tail call reuses this call's depth and callee slot; its
+        // arguments move from the value stack into its fresh frame.
+        function = literal_as_function(result.value);
+        size_t arguments_count = function->function->params.count;
+        Literal *arguments = &stack.value[stack.count - arguments_count];
+        environment = environment_push(NULL, function->function->slots_count);
+        for (size_t i = 0; i < arguments_count; ++i)
+        {
+            environment_define_at(&environment, i, arguments[i]);
+        }
+        stack.value[callee_slot] = result.value;
+        stack.count = callee_slot + 1;
     }
+    call_depth--;
+    closure = previous;
+    stack.count--;
+    return result.value;
+}
 
-    return (Literal){
-        .type = LITERAL_NONE,
-        .value.s = NULL,
-    };
+static Literal interpreter_visit_none_expr(Expr *expr)
+{
+    (void)expr;
+    return literal_none();
 }
 
-static Literal interpreter_visit_logical_expr(ExprLogical *expr)
+static ObjectClosure *interpreter_callee(Literal callee, size_t arguments_count)
 {
-    Literal left = interpreter_evaluate(expr->left);
+    if (!literal_is_function(callee))
+    {
+        fprintf(stderr, "Can only call functions.\n");
+        exit(70);
+    }
 
-    if (expr->operator->type == TOKEN_TYPE_OR)
+    ObjectClosure *function = literal_as_function(callee);
+    if (function->function->params.count != arguments_count)
     {
-        if (interpreter_is_truthy(left))
-            return left;
+        fprintf(stderr, "Wrong number of arguments to '%s'.\n", function->function->name->name->chars);
+        exit(70);
     }
-    else
+
+    return function;
+}
+
+static ObjectClosure *interpreter_closure(StmtFunction *stmt)
+{
+    // Captured slots get their cells before the closure is allocated; the
+    // frames keep the cells alive while it is.
+    for (size_t i = 0; i < stmt->upvalues.count; ++i)
     {
-        if (!interpreter_is_truthy(left))
-            return left;
+        StmtUpvalue *upvalue = &stmt->upvalues.value[i];
+        if (upvalue->is_local)
+        {
+            environment_capture(environment_ptr, upvalue->depth, upvalue->slot);
+        }
     }
 
-    return interpreter_evaluate(expr->right);
+    ObjectClosure *result = object_new_closure(stmt, stmt->upvalues.count);
+    for (size_t i = 0; i < stmt->upvalues.count; ++i)
+    {
+        StmtUpvalue *upvalue = &stmt->upvalues.value[i];
+        result->upvalues[i] = upvalue->is_local ? environment_capture(environment_ptr, upvalue->depth, upvalue->slot) : closure->upvalues[upvalue->slot];
+    }
+    return result;
 }
 
-static Literal interpreter_visit_call_expr(ExprCall *expr)
+static Literal interpreter_concatenate(Literal left, Literal right)
 {
-    Literal callee = interpreter_evaluate(expr->callee);
+    interpreter_push(left);
+    interpreter_push(right);
+    Literal result = literal_concatenate(left, right);
+    stack.count -= 2;
+    return result;
+}
 
-    Literal *literals = malloc(256 * sizeof(Literal));
-    for (size_t i = 0; i < expr->arguments.count; ++i)
+static void interpreter_push(Literal literal)
+{
+    if (stack.count == stack_capacity)
     {
-        literals[i] = interpreter_evaluate(expr->arguments.value[i]);
+        stack_capacity = stack_capacity < 64 ? 64 : stack_capacity * 2;
+        stack.value = realloc(stack.value, stack_capacity * sizeof(Literal));
     }
 
-    LoxCallableFn function = callee.value.f.f;
-    return function(
-        environment_ptr,
-        callee.value.f.stmt,
-        (Literals){
-            .count = expr->arguments.count,
-            .value = literals,
-        });
+    stack.value[stack.count++] = literal;
 }
 
-void intepreter_free(Literal *literal)
+static void interpreter_mark_roots(void)
 {
-    if (literal->type == LITERAL_STRING && literal->is_owned)
+    table_mark(&globals);
+    environment_mark();
+    for (size_t i = 0; i < stack.count; ++i)
     {
-        free(literal->value.s);
+        memory_mark_literal(stack.value[i]);
     }
-}
\ No newline at end of file
+}
@@ -9,25 +9,24 @@
 typedef struct
 {
     Statements statements;
-    Environment *environment_ptr;
+    size_t max_depth;
 } Interpreter;
 
 typedef enum
 {
     INTERPRETER_RESULT_TYPE_NEXT,
     INTERPRETER_RESULT_TYPE_RETURN,
+    INTERPRETER_RESULT_TYPE_TAIL_CALL,
     INTERPRETER_RESULT_TYPE_NONE,
 } InterpreterResultType;
 
-typedef struct
+struct InterpreterResult
 {
     InterpreterResultType type;
     Literal value;
-} InterpreterResult;
+};
 
-void intepreter_init(Interpreter *interpreter);
 void intepreter_interpret(Interpreter *interpreter);
 InterpreterResult interpreter_execute_block(Statements *statements, Environment *block_environment);
-void intepreter_free(Literal *literal);
 
 #endif
\ No newline at end of file
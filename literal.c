@@ -0,0 +1,126 @@
+#include "literal.h"
+#include "object.h"
+#include <stdio.h>
+#include <string.h>
+
+Literal literal_copy_string(const char *chars, size_t length)
+{
+    if (length <= LITERAL_INLINE_STRING_MAX)
+    {
+        return literal_inline_string(chars, length);
+    }
+
+    return literal_string(object_copy_string(chars, length));
+}
+
+Literal literal_concatenate(Literal left, Literal right)
+{
+    size_t left_length = literal_string_length(left);
+    size_t right_length = literal_string_length(right);
+    if (left_length + right_length <= LITERAL_INLINE_STRING_MAX)
+    {
+        char chars[LITERAL_INLINE_STRING_MAX];
+        memcpy(chars, literal_string_chars(&left), left_length);
+        memcpy(chars + left_length, literal_string_chars(&right), right_length);
+        return literal_inline_string(chars, left_length + right_length);
+    }
+
+    return literal_object(object_concatenate(left, right));
+}
+
+const char *literal_string_chars(const Literal *literal)
+{
+    if (literal_is_inline_string(*literal))
+    {
+        return literal_inline_chars(literal);
+    }
+
+    return object_string_chars(literal_as_object(*literal));
+}
+
+size_t literal_string_length(Literal literal)
+{
+    if (literal_is_inline_string(literal))
+    {
+        return literal_inline_length(literal);
+    }
+
+    return object_string_length(literal_as_object(literal));
+}
+
+bool literal_is_truthy(Literal literal)
+{
+    if (literal_is_none(literal))
+    {
+        return false;
+    }
+
+    if (literal_is_bool(literal))
+    {
+        return literal_as_bool(literal);
+    }
+
+    return true;
+}
+
+bool literal_is_equal(Literal left, Literal right)
+{
+    LiteralType type = literal_type(left);
+    if (type != literal_type(right))
+    {
+        return false;
+    }
+
+    switch (type)
+    {
+    case LITERAL_NONE:
+        return true;
+    case LITERAL_NUMBER:
+        return literal_as_number(left) == literal_as_number(right);
+    case LITERAL_BOOL:
+        return literal_as_bool(left) == literal_as_bool(right);
+    case LITERAL_STRING:
+        if (literal_is_inline_string(left) != literal_is_inline_string(right))
+        {
+            return false;
+        }
+
+        if (literal_is_inline_string(left))
+        {
+            size_t length = literal_inline_length(left);
+            return length == literal_inline_length(right) && memcmp(literal_inline_chars(&left), literal_inline_chars(&right), length) == 0;
+        }
+
+        return object_string_equal(literal_as_object(left), literal_as_object(right));
+    case LITERAL_FUNCTION:
+        return literal_as_function(left) == literal_as_function(right);
+    case LITERAL_COMPILED_FUNCTION:
+        return literal_as_compiled_function(left) == literal_as_compiled_function(right);
+    default:
+        return false;
+    }
+}
+
+void literal_print(Literal literal)
+{
+    switch (literal_type(literal))
+    {
+    case LITERAL_STRING:
+    {
+        fwrite(literal_string_chars(&literal), 1, literal_string_length(literal), stdout);
+        fputc('\n', stdout);
+        break;
+    }
+    case LITERAL_NUMBER:
+        fprintf(stdout, "%f\n", literal_as_number(literal));
+        break;
+    case LITERAL_BOOL:
+        fprintf(stdout, "%s\n", literal_as_bool(literal) ? "true" : "false");
+        break;
+    case LITERAL_NONE:
+        fprintf(stdout, "nil\n");
+        break;
+    default:
+        break;
+    }
+}
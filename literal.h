@@ -0,0 +1,356 @@
+#ifndef LITERAL_H
+#define LITERAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef struct CompiledFunction CompiledFunction;
+typedef struct Object Object;
+typedef struct ObjectString ObjectString;
+typedef struct ObjectClosure ObjectClosure;
+
+typedef enum
+{
+    LITERAL_STRING,
+    LITERAL_NUMBER,
+    LITERAL_BOOL,
+    LITERAL_FUNCTION,
+    LITERAL_COMPILED_FUNCTION,
+    LITERAL_NONE
+} LiteralType;
+
+#ifdef NAN_BOXING
+
+// Doubles are stored as-is. Everything else lives in the payload of a quiet
+// NaN: nil and booleans in the low bits, pointers in the low 48 bits with the
+// sign bit set and a two bit pointer tag above them. Strings of up to five
+// bytes use the pointer bits themselves: the bytes in the low 40 bits (in
+// memory order on little-endian targets) and the length above them.
+typedef uint64_t Literal;
+
+#define LITERAL_INLINE_STRING_MAX 5
+
+#define LITERAL_SIGN_BIT ((uint64_t)0x8000000000000000)
+#define LITERAL_QNAN ((uint64_t)0x7ffc000000000000)
+#define LITERAL_POINTER_MASK ((uint64_t)0x0000ffffffffffff)
+#define LITERAL_TAG_MASK ((uint64_t)3 << 48)
+#define LITERAL_TAG_STRING ((uint64_t)0 << 48)
+#define LITERAL_TAG_INLINE_STRING ((uint64_t)1 << 48)
+#define LITERAL_TAG_FUNCTION ((uint64_t)2 << 48)
+#define LITERAL_TAG_COMPILED_FUNCTION ((uint64_t)3 << 48)
+#define LITERAL_TAG_NOT_STRING ((uint64_t)2 << 48)
+#define LITERAL_NONE_BITS (LITERAL_QNAN | 1)
+#define LITERAL_FALSE_BITS (LITERAL_QNAN | 2)
+#define LITERAL_TRUE_BITS (LITERAL_QNAN | 3)
+
+static inline Literal literal_number(double number)
+{
+    Literal literal;
+    memcpy(&literal, &number, sizeof(number));
+    return literal;
+}
+
+static inline Literal literal_bool(bool b)
+{
+    return b ? LITERAL_TRUE_BITS : LITERAL_FALSE_BITS;
+}
+
+static inline Literal literal_none(void)
+{
+    return LITERAL_NONE_BITS;
+}
+
+static inline Literal literal_object(Object *o)
+{
+    return LITERAL_SIGN_BIT | LITERAL_QNAN | LITERAL_TAG_STRING | ((uint64_t)(uintptr_t)o & LITERAL_POINTER_MASK);
+}
+
+static inline Literal literal_inline_string(const char *chars, size_t length)
+{
+    uint64_t bits = 0;
+    memcpy(&bits, chars, length);
+    return LITERAL_SIGN_BIT | LITERAL_QNAN | LITERAL_TAG_INLINE_STRING | ((uint64_t)length << 40) | bits;
+}
+
+static inline Literal literal_function(ObjectClosure *f)
+{
+    return LITERAL_SIGN_BIT | LITERAL_QNAN | LITERAL_TAG_FUNCTION | ((uint64_t)(uintptr_t)f & LITERAL_POINTER_MASK);
+}
+
+static inline Literal literal_compiled_function(CompiledFunction *c)
+{
+    return LITERAL_SIGN_BIT | LITERAL_QNAN | LITERAL_TAG_COMPILED_FUNCTION | ((uint64_t)(uintptr_t)c & LITERAL_POINTER_MASK);
+}
+
+static inline bool literal_is_number(Literal literal)
+{
+    return (literal & LITERAL_QNAN) != LITERAL_QNAN;
+}
+
+static inline bool literal_is_bool(Literal literal)
+{
+    return (literal | 1) == LITERAL_TRUE_BITS;
+}
+
+static inline bool literal_is_none(Literal literal)
+{
+    return literal == LITERAL_NONE_BITS;
+}
+
+static inline bool literal_is_pointer(Literal literal, uint64_t tag)
+{
+    return (literal & (LITERAL_SIGN_BIT | LITERAL_QNAN | LITERAL_TAG_MASK)) == (LITERAL_SIGN_BIT | LITERAL_QNAN | tag);
+}
+
+static inline bool literal_is_string(Literal literal)
+{
+    return (literal & (LITERAL_SIGN_BIT | LITERAL_QNAN | LITERAL_TAG_NOT_STRING)) == (LITERAL_SIGN_BIT | LITERAL_QNAN);
+}
+
+static inline bool literal_is_inline_string(Literal literal)
+{
+    return literal_is_pointer(literal, LITERAL_TAG_INLINE_STRING);
+}
+
+static inline bool literal_is_function(Literal literal)
+{
+    return literal_is_pointer(literal, LITERAL_TAG_FUNCTION);
+}
+
+static inline bool literal_is_compiled_function(Literal literal)
+{
+    return literal_is_pointer(literal, LITERAL_TAG_COMPILED_FUNCTION);
+}
+
+static inline double literal_as_number(Literal literal)
+{
+    double number;
+    memcpy(&number, &literal, sizeof(number));
+    return number;
+}
+
+static inline bool literal_as_bool(Literal literal)
+{
+    return literal == LITERAL_TRUE_BITS;
+}
+
+static inline Object *literal_as_object(Literal literal)
+{
+    return (Object *)(uintptr_t)(literal & LITERAL_POINTER_MASK);
+}
+
+static inline const char *literal_inline_chars(const Literal *literal)
+{
+    return (const char *)literal;
+}
+
+static inline size_t literal_inline_length(Literal literal)
+{
+    return (size_t)((literal >> 40) & 0xff);
+}
+
+static inline ObjectClosure *literal_as_function(Literal literal)
+{
+    return (ObjectClosure *)(uintptr_t)(literal & LITERAL_POINTER_MASK);
+}
+
+static inline CompiledFunction *literal_as_compiled_function(Literal literal)
+{
+    return (CompiledFunction *)(uintptr_t)(literal & LITERAL_POINTER_MASK);
+}
+
+static inline LiteralType literal_type(Literal literal)
+{
+    if (literal_is_number(literal))
+    {
+        return LITERAL_NUMBER;
+    }
+
+    if (literal & LITERAL_SIGN_BIT)
+    {
+        switch (literal & LITERAL_TAG_MASK)
+        {
+        case LITERAL_TAG_STRING:
+        case LITERAL_TAG_INLINE_STRING:
+            return LITERAL_STRING;
+        case LITERAL_TAG_FUNCTION:
+            return LITERAL_FUNCTION;
+        default:
+            return LITERAL_COMPILED_FUNCTION;
+        }
+    }
+
+    return literal_is_none(literal) ? LITERAL_NONE : LITERAL_BOOL;
+}
+
+#else
+
+#define LITERAL_INLINE_STRING_MAX 14
+
+// Storage tag for strings kept inside the literal; literal_type reports them
+// as LITERAL_STRING.
+#define LITERAL_INLINE_STRING_TYPE 0x80
+
+// Both views start with the type byte. Strings of up to
+// LITERAL_INLINE_STRING_MAX bytes fill the rest of the literal instead of
+// pointing at a heap object.
+typedef union
+{
+    struct
+    {
+        uint8_t type;
+        union
+        {
+            Object *o;
+            double i;
+            bool b;
+            ObjectClosure *f;
+            CompiledFunction *c;
+        } as;
+    } value;
+    struct
+    {
+        uint8_t type;
+        uint8_t length;
+        char chars[LITERAL_INLINE_STRING_MAX];
+    } inline_string;
+} Literal;
+
+static inline Literal literal_number(double number)
+{
+    return (Literal){.value = {.type = LITERAL_NUMBER, .as.i = number}};
+}
+
+static inline Literal literal_bool(bool b)
+{
+    return (Literal){.value = {.type = LITERAL_BOOL, .as.b = b}};
+}
+
+static inline Literal literal_none(void)
+{
+    return (Literal){.value = {.type = LITERAL_NONE, .as.o = NULL}};
+}
+
+static inline Literal literal_object(Object *o)
+{
+    return (Literal){.value = {.type = LITERAL_STRING, .as.o = o}};
+}
+
+static inline Literal literal_inline_string(const char *chars, size_t length)
+{
+    Literal literal = {.inline_string = {.type = LITERAL_INLINE_STRING_TYPE, .length = (uint8_t)length}};
+    memcpy(literal.inline_string.chars, chars, length);
+    return literal;
+}
+
+static inline Literal literal_function(ObjectClosure *f)
+{
+    return (Literal){.value = {.type = LITERAL_FUNCTION, .as.f = f}};
+}
+
+static inline Literal literal_compiled_function(CompiledFunction *c)
+{
+    return (Literal){.value = {.type = LITERAL_COMPILED_FUNCTION, .as.c = c}};
+}
+
+static inline bool literal_is_number(Literal literal)
+{
+    return literal.value.type == LITERAL_NUMBER;
+}
+
+static inline bool literal_is_bool(Literal literal)
+{
+    return literal.value.type == LITERAL_BOOL;
+}
+
+static inline bool literal_is_none(Literal literal)
+{
+    return literal.value.type == LITERAL_NONE;
+}
+
+static inline bool literal_is_string(Literal literal)
+{
+    return literal.value.type == LITERAL_STRING || literal.value.type == LITERAL_INLINE_STRING_TYPE;
+}
+
+static inline bool literal_is_inline_string(Literal literal)
+{
+    return literal.value.type == LITERAL_INLINE_STRING_TYPE;
+}
+
+static inline bool literal_is_function(Literal literal)
+{
+    return literal.value.type == LITERAL_FUNCTION;
+}
+
+static inline bool literal_is_compiled_function(Literal literal)
+{
+    return literal.value.type == LITERAL_COMPILED_FUNCTION;
+}
+
+static inline double literal_as_number(Literal literal)
+{
+    return literal.value.as.i;
+}
+
+static inline bool literal_as_bool(Literal literal)
+{
+    return literal.value.as.b;
+}
+
+static inline Object *literal_as_object(Literal literal)
+{
+    return literal.value.as.o;
+}
+
+static inline const char *literal_inline_chars(const Literal *literal)
+{
+    return literal->inline_string.chars;
+}
+
+static inline size_t literal_inline_length(Literal literal)
+{
+    return literal.inline_string.length;
+}
+
+static inline ObjectClosure *literal_as_function(Literal literal)
+{
+    return literal.value.as.f;
+}
+
+static inline CompiledFunction *literal_as_compiled_function(Literal literal)
+{
+    return literal.value.as.c;
+}
+
+static inline LiteralType literal_type(Literal literal)
+{
+    return literal.value.type == LITERAL_INLINE_STRING_TYPE ? LITERAL_STRING : (LiteralType)literal.value.type;
+}
+
+#endif
+
+// String values are inline strings, interned ObjectStrings or builders
+// produced by concatenation. Every string short enough to be inline is
+// inline, so the kinds never need comparing against each other.
+// literal_as_string is only valid for the interned kind.
+static inline Literal literal_string(ObjectString *s)
+{
+    return literal_object((Object *)s);
+}
+
+static inline ObjectString *literal_as_string(Literal literal)
+{
+    return (ObjectString *)literal_as_object(literal);
+}
+
+Literal literal_copy_string(const char *chars, size_t length);
+Literal literal_concatenate(Literal left, Literal right);
+const char *literal_string_chars(const Literal *literal);
+size_t literal_string_length(Literal literal);
+bool literal_is_truthy(Literal literal);
+bool literal_is_equal(Literal left, Literal right);
+void literal_print(Literal literal);
+
+#endif
@@ -5,43 +5,75 @@
 #include "scanner.h"
 #include "token.h"
 #include "parser.h"
+#include "arena.h"
 #include "interpreter.h"
 #include "stmt.h"
+#include "compiler.h"
+#include "resolver.h"
+#include "vm.h"
+#include "memory.h"
 
-void lox_run(const char *filename)
+void lox_run(const char *filename, LoxEngine engine, size_t max_depth)
 {
-    char *c = util_read_file(filename);
+    SourceFile source;
+    if (!util_open_source(filename, &source))
+    {
+        fprintf(stderr, "Could not open file '%s'.\n", filename);
+        exit(74);
+    }
+
     Scanner scanner = {
-        .source = c,
+        .source = source.data,
+        .length = source.length,
     };
     scanner_init(&scanner);
     scanner_tokens(&scanner);
 
+    Arena arena;
+    arena_init(&arena);
+
     Parser parser = {
-        .tokens = scanner.tokens,
+        .tokens = &scanner.tokens,
+        .arena = &arena,
     };
     parser_init(&parser);
     Statements statements = parser_parse(&parser);
+    parser_free(&parser);
 
     if (parser.had_error)
     {
         fprintf(stderr, "Unexpected expression\n");
     }
 
-    Interpreter interpreter = {
-        .statements = statements,
-        .environment_ptr = NULL,
-    };
-    intepreter_init(&interpreter);
-    intepreter_interpret(&interpreter);
+    memory_pin_objects();
 
-    // for (size_t i = 0; i < scanner.tokens_count; ++i)
-    // {
-    //     Token token = scanner.tokens[i];
-    //     token_free(&token);
-    // }
+    if (engine == LOX_ENGINE_VM)
+    {
+        CompiledFunction *function = compiler_compile(&statements);
+        if (function == NULL)
+        {
+            exit(65);
+        }
+
+        VmResult result = vm_interpret(function, max_depth);
+        compiler_free(function);
+        if (result == VM_RESULT_RUNTIME_ERROR)
+        {
+            exit(70);
+        }
+    }
+    else if (resolver_resolve(&statements, &arena))
+    {
+        Interpreter interpreter = {
+            .statements = statements,
+            .max_depth = max_depth,
+        };
+        intepreter_interpret(&interpreter);
+    }
 
-    // expr_free(expr);
     // intepreter_free(&literal);
-    free(c);
+    memory_free_objects();
+    arena_free(&arena);
+    scanner_free(&scanner);
+    util_close_source(&source);
 }
\ No newline at end of file
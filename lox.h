@@ -1,6 +1,17 @@
 #ifndef LOX_H
 #define LOX_H
 
-void lox_run(const char *filename);
+#include <stddef.h>
 
-#endif
\ No newline at end of file
+#define LOX_MAX_DEPTH_DEFAULT 100000
+#define LOX_MAX_DEPTH_MAX 1000000
+
+typedef enum
+{
+    LOX_ENGINE_TREE,
+    LOX_ENGINE_VM,
+} LoxEngine;
+
+void lox_run(const char *filename, LoxEngine engine, size_t max_depth);
+
+#endif
@@ -3,20 +3,9 @@
 #include "interpreter.h"
 #include <stdio.h>
 
-Literal lox_function_call(Environment *environment_ptr, StmtFunction *stmt, Literals arguments)
+InterpreterResult lox_function_call(Environment *environment, StmtFunction *stmt)
 {
-    Environment environment = {
-        .enclosing = environment_ptr,
-        .entries = {
-            .count = 0,
-            .value = {},
-        },
-    };
-
-    for (size_t i = 0; i < stmt->params.count; ++i)
-    {
-        environment_define(&environment, stmt->params.value[i]->lexeme, arguments.value[i]);
-    }
-
-    return interpreter_execute_block(&stmt->body, &environment).value;
+    InterpreterResult result = interpreter_execute_block(&stmt->body, environment);
+    environment_pop(environment);
+    return result;
 }
\ No newline at end of file
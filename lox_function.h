@@ -4,9 +4,11 @@
 #include "token.h"
 #include "stmt.h"
 #include "environment.h"
+#include "interpreter.h"
 
-typedef Literal (*LoxCallableFn)(Environment *environment_ptr, StmtFunction *stmt, Literals arguments);
-
-Literal lox_function_call(Environment *environment_ptr, StmtFunction *stmt, Literals arguments);
+// `environment` is the callee's frame, pushed by the caller with the
+// arguments already in the parameter slots. The frame is popped on return,
+// including when the body ends in a tail call.
+InterpreterResult lox_function_call(Environment *environment, StmtFunction *stmt);
 
 #endif
\ No newline at end of file
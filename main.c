@@ -1,13 +1,61 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "lox.h"
+#include "memory.h"
 
 int main(int argc, char *argv[])
 {
-    if (argc < 2)
+    LoxEngine engine = LOX_ENGINE_TREE;
+    const char *filename = NULL;
+    bool gc_stats = false;
+    size_t max_depth = LOX_MAX_DEPTH_DEFAULT;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--engine=tree") == 0)
+        {
+            engine = LOX_ENGINE_TREE;
+        }
+        else if (strcmp(argv[i], "--engine=vm") == 0)
+        {
+            engine = LOX_ENGINE_VM;
+        }
+        else if (strcmp(argv[i], "--gc-stats") == 0)
+        {
+            gc_stats = true;
+        }
+        else if (strncmp(argv[i], "--max-depth=", 12) == 0)
+        {
+            char *end;
+            unsigned long value = strtoul(argv[i] + 12, &end, 10);
+            if (end == argv[i] + 12 || *end != '\0' || value == 0 || value > LOX_MAX_DEPTH_MAX)
+            {
+                fprintf(stderr, "Invalid max depth '%s'; expected 1 to %d\n", argv[i] + 12, LOX_MAX_DEPTH_MAX);
+                return 1;
+            }
+            max_depth = (size_t)value;
+        }
+        else if (strncmp(argv[i], "--engine=", 9) == 0)
+        {
+            fprintf(stderr, "Unknown engine '%s'\n", argv[i] + 9);
+            return 1;
+        }
+        else
+        {
+            filename = argv[i];
+        }
+    }
+
+    if (filename == NULL)
     {
         fprintf(stderr, "Please input a file\n");
         return 1;
     }
-    lox_run(argv[1]);
+    lox_run(filename, engine, max_depth);
+    if (gc_stats)
+    {
+        memory_print_stats();
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,277 @@
+#include "memory.h"
+#include <stdio.h>
+#include <time.h>
+
+#define MEMORY_GC_MIN_THRESHOLD (1024 * 1024)
+#define MEMORY_GC_GROW_FACTOR 2
+
+typedef struct
+{
+    size_t collections;
+    size_t bytes_freed;
+    size_t bytes_peak;
+    double pause_total;
+    double pause_max;
+} MemoryStats;
+
+typedef struct
+{
+    Object *objects;
+    Object *pinned;
+    size_t bytes_allocated;
+    size_t next_gc;
+    MemoryMarkRootsFn mark_roots;
+    Object **gray;
+    size_t gray_count;
+    size_t gray_capacity;
+    MemoryStats stats;
+} Memory;
+
+static Memory memory = {
+    .objects = NULL,
+    .pinned = NULL,
+    .bytes_allocated = 0,
+    .next_gc = MEMORY_GC_MIN_THRESHOLD,
+    .mark_roots = NULL,
+    .gray = NULL,
+    .gray_count = 0,
+    .gray_capacity = 0,
+};
+
+static void memory_trace_references(void);
+static void memory_blacken_object(Object *object);
+static void memory_sweep(void);
+static double memory_now(void);
+
+void *memory_reallocate(void *pointer, size_t old_size, size_t new_size)
+{
+    memory.bytes_allocated += new_size;
+    memory.bytes_allocated -= old_size;
+
+    if (new_size > old_size)
+    {
+#ifdef GC_STRESS
+        memory_collect();
+#else
+        if (memory.bytes_allocated > memory.next_gc)
+        {
+            memory_collect();
+        }
+#endif
+        if (memory.bytes_allocated > memory.stats.bytes_peak)
+        {
+            memory.stats.bytes_peak = memory.bytes_allocated;
+        }
+    }
+
+    if (new_size == 0)
+    {
+        free(pointer);
+        return NULL;
+    }
+
+    void *result = realloc(pointer, new_size);
+    if (result == NULL)
+    {
+        fprintf(stderr, "Out of memory.\n");
+        exit(74);
+    }
+
+    return result;
+}
+
+void memory_track_object(Object *object, ObjectType type)
+{
+    object->type = type;
+    object->is_marked = false;
+    object->next = memory.objects;
+    memory.objects = object;
+}
+
+void memory_set_roots(MemoryMarkRootsFn mark_roots)
+{
+    memory.mark_roots = mark_roots;
+}
+
+void memory_pin_objects(void)
+{
+    // Objects created while loading a script (string literals in the AST and
+    // in constant pools) live as long as the program, so they are moved out
+    // of the collector's reach instead of being traced from the AST. They stay
+    // marked so the intern table never drops them either.
+    while (memory.objects != NULL)
+    {
+        Object *object = memory.objects;
+        memory.objects = object->next;
+        object->next = memory.pinned;
+        object->is_marked = true;
+        memory.pinned = object;
+    }
+}
+
+void memory_mark_literal(Literal literal)
+{
+    if (literal_is_string(literal) && !literal_is_inline_string(literal))
+    {
+        memory_mark_object(literal_as_object(literal));
+    }
+    else if (literal_is_function(literal))
+    {
+        memory_mark_object((Object *)literal_as_function(literal));
+    }
+}
+
+void memory_mark_object(Object *object)
+{
+    if (object == NULL || object->is_marked)
+    {
+        return;
+    }
+
+    object->is_marked = true;
+    if (object->type == OBJECT_TYPE_STRING || object->type == OBJECT_TYPE_BUFFER)
+    {
+        return;
+    }
+
+    // Objects with references are traced later from the gray list, so long
+    // chains of closures do not recurse on the C stack. The list is grown
+    // with plain realloc; growing it must not start another collection.
+    if (memory.gray_count == memory.gray_capacity)
+    {
+        memory.gray_capacity = memory.gray_capacity < 64 ? 64 : memory.gray_capacity * 2;
+        memory.gray = realloc(memory.gray, memory.gray_capacity * sizeof(Object *));
+    }
+
+    memory.gray[memory.gray_count++] = object;
+}
+
+void memory_collect(void)
+{
+    if (memory.mark_roots == NULL)
+    {
+        return;
+    }
+
+    double start = memory_now();
+    size_t before = memory.bytes_allocated;
+
+    memory.mark_roots();
+    memory_trace_references();
+    object_sweep_strings();
+    memory_sweep();
+
+    memory.next_gc = memory.bytes_allocated * MEMORY_GC_GROW_FACTOR;
+    if (memory.next_gc < MEMORY_GC_MIN_THRESHOLD)
+    {
+        memory.next_gc = MEMORY_GC_MIN_THRESHOLD;
+    }
+
+    double pause = memory_now() - start;
+    memory.stats.collections++;
+    memory.stats.bytes_freed += before - memory.bytes_allocated;
+    memory.stats.pause_total += pause;
+    if (pause > memory.stats.pause_max)
+    {
+        memory.stats.pause_max = pause;
+    }
+}
+
+void memory_free_objects(void)
+{
+    Object *lists[] = {memory.objects, memory.pinned};
+    for (size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); ++i)
+    {
+        Object *object = lists[i];
+        while (object != NULL)
+        {
+            Object *next = object->next;
+            object_free(object);
+            object = next;
+        }
+    }
+
+    object_free_strings();
+    free(memory.gray);
+    memory.gray = NULL;
+    memory.gray_capacity = 0;
+    memory.objects = NULL;
+    memory.pinned = NULL;
+    memory.mark_roots = NULL;
+}
+
+void memory_print_stats(void)
+{
+    fflush(stdout);
+    fprintf(stderr, "gc: %zu collections, %zu bytes freed, %zu bytes peak\n", memory.stats.collections, memory.stats.bytes_freed, memory.stats.bytes_peak);
+    fprintf(stderr, "gc: %.3f ms total pause, %.3f ms max pause\n", memory.stats.pause_total * 1000, memory.stats.pause_max * 1000);
+}
+
+static void memory_trace_references(void)
+{
+    while (memory.gray_count > 0)
+    {
+        memory_blacken_object(memory.gray[--memory.gray_count]);
+    }
+}
+
+static void memory_blacken_object(Object *object)
+{
+    switch (object->type)
+    {
+    case OBJECT_TYPE_BUILDER:
+        memory_mark_object((Object *)((ObjectBuilder *)object)->buffer);
+        break;
+    case OBJECT_TYPE_UPVALUE:
+        memory_mark_literal(((ObjectUpvalue *)object)->value);
+        break;
+    case OBJECT_TYPE_CLOSURE:
+    {
+        ObjectClosure *closure = (ObjectClosure *)object;
+        for (size_t i = 0; i < closure->upvalue_count; ++i)
+        {
+            memory_mark_object((Object *)closure->upvalues[i]);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void memory_sweep(void)
+{
+    Object *previous = NULL;
+    Object *object = memory.objects;
+
+    while (object != NULL)
+    {
+        if (object->is_marked)
+        {
+            object->is_marked = false;
+            previous = object;
+            object = object->next;
+            continue;
+        }
+
+        Object *unreached = object;
+        object = object->next;
+        if (previous != NULL)
+        {
+            previous->next = object;
+        }
+        else
+        {
+            memory.objects = object;
+        }
+
+        object_free(unreached);
+    }
+}
+
+static double memory_now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+}
@@ -0,0 +1,20 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include "literal.h"
+#include "object.h"
+#include <stdlib.h>
+
+typedef void (*MemoryMarkRootsFn)(void);
+
+void *memory_reallocate(void *pointer, size_t old_size, size_t new_size);
+void memory_track_object(Object *object, ObjectType type);
+void memory_set_roots(MemoryMarkRootsFn mark_roots);
+void memory_pin_objects(void);
+void memory_mark_literal(Literal literal);
+void memory_mark_object(Object *object);
+void memory_collect(void);
+void memory_free_objects(void);
+void memory_print_stats(void);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef NUMBER_H
+#define NUMBER_H
+
+#include <stdlib.h>
+
+double number_parse(const char *start, size_t length);
+
+#endif
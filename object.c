@@ -0,0 +1,207 @@
+#include "object.h"
+#include "memory.h"
+#include "table.h"
+#include <string.h>
+
+#define OBJECT_BUILDER_MIN_LENGTH 64
+#define OBJECT_BUFFER_MIN_CAPACITY 256
+
+// Every string is interned: equal contents always share one object, so
+// strings compare by identity and tables reuse the cached hash.
+static Table strings = {
+    .count = 0,
+    .capacity = 0,
+    .entries = NULL,
+};
+
+static ObjectClosure *object_allocate_closure(size_t upvalue_count);
+static ObjectString *object_allocate_string(size_t length);
+static ObjectBuilder *object_append(ObjectBuilder *builder, const char *chars, size_t length);
+static ObjectString *object_intern(ObjectString *string, uint32_t hash);
+
+ObjectString *object_copy_string(const char *chars, size_t length)
+{
+    uint32_t hash = table_hash(chars, length);
+    ObjectString *interned = table_find_string(&strings, chars, length, hash);
+    if (interned != NULL)
+    {
+        return interned;
+    }
+
+    ObjectString *string = object_allocate_string(length);
+    memcpy(string->chars, chars, length);
+    return object_intern(string, hash);
+}
+
+Object *object_concatenate(Literal left, Literal right)
+{
+    const char *left_chars = literal_string_chars(&left);
+    const char *right_chars = literal_string_chars(&right);
+    size_t left_length = literal_string_length(left);
+    size_t right_length = literal_string_length(right);
+    size_t length = left_length + right_length;
+
+    if (!literal_is_inline_string(left) && literal_as_object(left)->type == OBJECT_TYPE_BUILDER)
+    {
+        ObjectBuilder *builder = (ObjectBuilder *)literal_as_object(left);
+        if (builder->length == builder->buffer->length && length <= builder->buffer->capacity)
+        {
+            return (Object *)object_append(builder, right_chars, right_length);
+        }
+    }
+
+    if (length < OBJECT_BUILDER_MIN_LENGTH)
+    {
+        ObjectString *string = object_allocate_string(length);
+        memcpy(string->chars, left_chars, left_length);
+        memcpy(string->chars + left_length, right_chars, right_length);
+        return (Object *)object_intern(string, table_hash(string->chars, length));
+    }
+
+    // Start a fresh buffer with room to grow. Both allocations happen before
+    // either is tracked, so a collection in between cannot reclaim them.
+    size_t capacity = length * 2 < OBJECT_BUFFER_MIN_CAPACITY ? OBJECT_BUFFER_MIN_CAPACITY : length * 2;
+    ObjectBuffer *buffer = memory_reallocate(NULL, 0, sizeof(ObjectBuffer) + capacity);
+    ObjectBuilder *builder = memory_reallocate(NULL, 0, sizeof(ObjectBuilder));
+    memory_track_object((Object *)buffer, OBJECT_TYPE_BUFFER);
+    memory_track_object((Object *)builder, OBJECT_TYPE_BUILDER);
+
+    buffer->capacity = capacity;
+    buffer->length = length;
+    memcpy(buffer->chars, left_chars, left_length);
+    memcpy(buffer->chars + left_length, right_chars, right_length);
+    builder->buffer = buffer;
+    builder->length = length;
+    return (Object *)builder;
+}
+
+bool object_string_equal(Object *left, Object *right)
+{
+    if (left == right)
+    {
+        return true;
+    }
+
+    if (left->type == OBJECT_TYPE_STRING && right->type == OBJECT_TYPE_STRING)
+    {
+        return false;
+    }
+
+    size_t length = object_string_length(left);
+    return length == object_string_length(right) && memcmp(object_string_chars(left), object_string_chars(right), length) == 0;
+}
+
+ObjectUpvalue *object_new_upvalue(Literal value)
+{
+    ObjectUpvalue *upvalue = memory_reallocate(NULL, 0, sizeof(ObjectUpvalue));
+    memory_track_object((Object *)upvalue, OBJECT_TYPE_UPVALUE);
+    upvalue->value = value;
+    upvalue->location = &upvalue->value;
+    upvalue->next = NULL;
+    return upvalue;
+}
+
+ObjectClosure *object_new_closure(StmtFunction *function, size_t upvalue_count)
+{
+    ObjectClosure *closure = object_allocate_closure(upvalue_count);
+    closure->function = function;
+    return closure;
+}
+
+ObjectClosure *object_new_compiled_closure(CompiledFunction *function, size_t upvalue_count)
+{
+    ObjectClosure *closure = object_allocate_closure(upvalue_count);
+    closure->compiled = function;
+    return closure;
+}
+
+void object_sweep_strings(void)
+{
+    table_remove_unmarked(&strings);
+}
+
+void object_free_strings(void)
+{
+    table_free(&strings);
+}
+
+void object_free(Object *object)
+{
+    switch (object->type)
+    {
+    case OBJECT_TYPE_STRING:
+    {
+        ObjectString *string = (ObjectString *)object;
+        memory_reallocate(string, sizeof(ObjectString) + string->length + 1, 0);
+        break;
+    }
+    case OBJECT_TYPE_BUFFER:
+        memory_reallocate(object, sizeof(ObjectBuffer) + ((ObjectBuffer *)object)->capacity, 0);
+        break;
+    case OBJECT_TYPE_BUILDER:
+        memory_reallocate(object, sizeof(ObjectBuilder), 0);
+        break;
+    case OBJECT_TYPE_UPVALUE:
+        memory_reallocate(object, sizeof(ObjectUpvalue), 0);
+        break;
+    case OBJECT_TYPE_CLOSURE:
+        memory_reallocate(object, sizeof(ObjectClosure) + ((ObjectClosure *)object)->upvalue_count * sizeof(ObjectUpvalue *), 0);
+        break;
+    default:
+        break;
+    }
+}
+
+static ObjectClosure *object_allocate_closure(size_t upvalue_count)
+{
+    ObjectClosure *closure = memory_reallocate(NULL, 0, sizeof(ObjectClosure) + upvalue_count * sizeof(ObjectUpvalue *));
+    memory_track_object((Object *)closure, OBJECT_TYPE_CLOSURE);
+    closure->function = NULL;
+    closure->compiled = NULL;
+    closure->upvalue_count = upvalue_count;
+    for (size_t i = 0; i < upvalue_count; ++i)
+    {
+        closure->upvalues[i] = NULL;
+    }
+    return closure;
+}
+
+static ObjectString *object_allocate_string(size_t length)
+{
+    // The header and the bytes share one allocation. It only becomes an
+    // object once interned, so a collection triggered here cannot see it.
+    ObjectString *string = memory_reallocate(NULL, 0, sizeof(ObjectString) + length + 1);
+    string->length = length;
+    string->chars[length] = '\0';
+    return string;
+}
+
+static ObjectString *object_intern(ObjectString *string, uint32_t hash)
+{
+    ObjectString *interned = table_find_string(&strings, string->chars, string->length, hash);
+    if (interned != NULL)
+    {
+        memory_reallocate(string, sizeof(ObjectString) + string->length + 1, 0);
+        return interned;
+    }
+
+    memory_track_object((Object *)string, OBJECT_TYPE_STRING);
+    string->hash = hash;
+    table_set(&strings, string, literal_none());
+    return string;
+}
+
+static ObjectBuilder *object_append(ObjectBuilder *builder, const char *chars, size_t length)
+{
+    // The buffer stays reachable through the left operand while the new
+    // builder is allocated.
+    ObjectBuffer *buffer = builder->buffer;
+    memcpy(buffer->chars + buffer->length, chars, length);
+    buffer->length += length;
+
+    ObjectBuilder *result = memory_reallocate(NULL, 0, sizeof(ObjectBuilder));
+    memory_track_object((Object *)result, OBJECT_TYPE_BUILDER);
+    result->buffer = buffer;
+    result->length = buffer->length;
+    return result;
+}
@@ -0,0 +1,110 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include "literal.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef enum
+{
+    OBJECT_TYPE_STRING,
+    OBJECT_TYPE_BUFFER,
+    OBJECT_TYPE_BUILDER,
+    OBJECT_TYPE_UPVALUE,
+    OBJECT_TYPE_CLOSURE,
+} ObjectType;
+
+typedef struct Object Object;
+typedef struct StmtFunction StmtFunction;
+
+struct Object
+{
+    ObjectType type;
+    bool is_marked;
+    Object *next;
+};
+
+struct ObjectString
+{
+    Object object;
+    size_t length;
+    uint32_t hash;
+    char chars[];
+};
+
+// Append-only storage shared by the builders that were cut from it.
+typedef struct
+{
+    Object object;
+    size_t length;
+    size_t capacity;
+    char chars[];
+} ObjectBuffer;
+
+// A string produced by concatenation: the first `length` bytes of a buffer.
+// Appending to the builder that ends at the buffer's tip extends the buffer
+// in place, so repeated `s = s + x` runs in amortized linear time.
+typedef struct
+{
+    Object object;
+    size_t length;
+    ObjectBuffer *buffer;
+} ObjectBuilder;
+
+// A captured variable. The frame slot it was captured from forwards to the
+// cell, so the frame and every closure share one value.
+//
+// The vm engine captures stack slots instead: `location` points at the slot
+// while it is live and at `value` once the slot is closed. Open upvalues
+// are chained through `next`, deepest slot first.
+typedef struct ObjectUpvalue ObjectUpvalue;
+
+struct ObjectUpvalue
+{
+    Object object;
+    Literal value;
+    Literal *location;
+    ObjectUpvalue *next;
+};
+
+// Closures made by the tree walker run `function`; those made by the vm
+// engine run `compiled`.
+struct ObjectClosure
+{
+    Object object;
+    StmtFunction *function;
+    CompiledFunction *compiled;
+    size_t upvalue_count;
+    ObjectUpvalue *upvalues[];
+};
+
+static inline const char *object_string_chars(Object *object)
+{
+    if (object->type == OBJECT_TYPE_BUILDER)
+    {
+        return ((ObjectBuilder *)object)->buffer->chars;
+    }
+    return ((ObjectString *)object)->chars;
+}
+
+static inline size_t object_string_length(Object *object)
+{
+    if (object->type == OBJECT_TYPE_BUILDER)
+    {
+        return ((ObjectBuilder *)object)->length;
+    }
+    return ((ObjectString *)object)->length;
+}
+
+ObjectString *object_copy_string(const char *chars, size_t length);
+Object *object_concatenate(Literal left, Literal right);
+bool object_string_equal(Object *left, Object *right);
+ObjectUpvalue *object_new_upvalue(Literal value);
+ObjectClosure *object_new_closure(StmtFunction *function, size_t upvalue_count);
+ObjectClosure *object_new_compiled_closure(CompiledFunction *function, size_t upvalue_count);
+void object_sweep_strings(void);
+void object_free_strings(void);
+void object_free(Object *object);
+
+#endif
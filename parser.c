@@ -1,6 +1,7 @@
 #include "parser.h"
 #include "expr.h"
 #include <stdio.h>
+#include <string.h>
 
 static bool parser_match(Parser *parser, enum TokenType token_type);
 static bool parser_check(Parser *parser, enum TokenType token_type);
@@ -16,6 +17,7 @@ static Stmt *parser_if_statement(Parser *parser);
 static Stmt *parser_print_statement(Parser *parser);
 static Stmt *parser_return_statement(Parser *parser);
 static Stmt *parser_while_statement(Parser *parser);
+static Stmt *parser_for_statement(Parser *parser);
 static Stmt *parser_function(Parser *parser);
 static Statements parser_block(Parser *parser);
 static Stmt *parser_expression_statement(Parser *parser);
@@ -31,24 +33,36 @@ static Expr *parser_unary(Parser *parser);
 static Expr *parser_call(Parser *parser);
 static Expr *parser_finish_callee(Parser *parser, Expr *callee);
 static Expr *parser_primary(Parser *parser);
+static void parser_scratch_push(Parser *parser, void *item);
+static void **parser_scratch_take(Parser *parser, size_t base);
 
 void parser_init(Parser *parser)
 {
     parser->current = 0;
+    parser->scratch = NULL;
+    parser->scratch_count = 0;
+    parser->scratch_capacity = 0;
+}
+
+void parser_free(Parser *parser)
+{
+    free(parser->scratch);
+    parser->scratch = NULL;
+    parser->scratch_count = 0;
+    parser->scratch_capacity = 0;
 }
 
 Statements parser_parse(Parser *parser)
 {
-    Stmt **stmt = malloc(256 * sizeof(Stmt *));
-    size_t i = 0;
+    size_t base = parser->scratch_count;
     while (!parser_is_at_end(parser))
     {
-        stmt[i++] = parser_declaration(parser);
+        parser_scratch_push(parser, parser_declaration(parser));
     }
 
     return (Statements){
-        .count = i,
-        .value = stmt,
+        .count = parser->scratch_count - base,
+        .value = (Stmt **)parser_scratch_take(parser, base),
     };
 }
 
@@ -97,12 +111,12 @@ static Token *parser_consume(Parser *parser, enum TokenType token_type, const ch
 
 static Token *parser_previous(Parser *parser)
 {
-    return &parser->tokens[parser->current - 1];
+    return &parser->tokens->value[parser->current - 1];
 }
 
 static Token *parser_peek(Parser *parser)
 {
-    return &parser->tokens[parser->current];
+    return &parser->tokens->value[parser->current];
 }
 
 static Stmt *parser_var_declaration(Parser *parser)
@@ -117,10 +131,10 @@ static Stmt *parser_var_declaration(Parser *parser)
 
     parser_consume(parser, TOKEN_TYPE_SEMICOLON, "Expect ';' after variable declaration.");
 
-    Stmt *stmt = malloc(sizeof(Stmt));
+    Stmt *stmt = arena_alloc(parser->arena, sizeof(Stmt));
     *stmt = (Stmt){
         .type = STMT_TYPE_VAR,
-        .as.var = {.initializer = initializer, .name = name},
+        .as.var = {.initializer = initializer, .name = name, .slot = -1},
     };
     return stmt;
 }
@@ -156,9 +170,13 @@ static Stmt *parser_statement(Parser *parser)
     {
         return parser_while_statement(parser);
     }
+    else if (parser_match(parser, TOKEN_TYPE_FOR))
+    {
+        return parser_for_statement(parser);
+    }
     else if (parser_match(parser, TOKEN_TYPE_LEFT_BRACE))
     {
-        Stmt *stmt = malloc(sizeof(Stmt));
+        Stmt *stmt = arena_alloc(parser->arena, sizeof(Stmt));
         *stmt = (Stmt){
             .type = STMT_TYPE_BLOCK,
             .as.block = {
@@ -176,7 +194,7 @@ static Stmt *parser_print_statement(Parser *parser)
     Expr *value = parser_expression(parser);
     parser_consume(parser, TOKEN_TYPE_SEMICOLON, "Expect ';' after value.");
 
-    Stmt *stmt = malloc(sizeof(Stmt));
+    Stmt *stmt = arena_alloc(parser->arena, sizeof(Stmt));
     *stmt = (Stmt){
         .type = STMT_TYPE_PRINT,
         .as.print = {.value = value},
@@ -195,10 +213,10 @@ static Stmt *parser_return_statement(Parser *parser)
 
     parser_consume(parser, TOKEN_TYPE_SEMICOLON, "Expect ';' after return value.");
 
-    Stmt *stmt = malloc(sizeof(Stmt));
+    Stmt *stmt = arena_alloc(parser->arena, sizeof(Stmt));
     *stmt = (Stmt){
         .type = STMT_TYPE_RETURN,
-        .as.returnn = {.keyword = keyword, .value = value},
+        .as.returnn = {.keyword = keyword, .value = value, .tail = false},
     };
     return stmt;
 }
@@ -216,7 +234,7 @@ static Stmt *parser_if_statement(Parser *parser)
         else_branch = parser_statement(parser);
     }
 
-    Stmt *stmt = malloc(sizeof(Stmt));
+    Stmt *stmt = arena_alloc(parser->arena, sizeof(Stmt));
     *stmt = (Stmt){
         .type = STMT_TYPE_IF,
         .as.iff = {
@@ -235,12 +253,86 @@ static Stmt *parser_while_statement(Parser *parser)
     parser_consume(parser, TOKEN_TYPE_RIGHT_PAREN, "Expect ')' after 'while'.");
     Stmt *body = parser_statement(parser);
 
-    Stmt *stmt = malloc(sizeof(Stmt));
+    Stmt *stmt = arena_alloc(parser->arena, sizeof(Stmt));
     *stmt = (Stmt){
         .type = STMT_TYPE_WHILE,
         .as.whilee = {
             .condition = condition,
             .body = body,
+            .increment = NULL,
+        },
+    };
+    return stmt;
+}
+
+static Stmt *parser_for_statement(Parser *parser)
+{
+    parser_consume(parser, TOKEN_TYPE_LEFT_PAREN, "Expect '(' after 'for'.");
+
+    Stmt *initializer = NULL;
+    if (parser_match(parser, TOKEN_TYPE_VAR))
+    {
+        initializer = parser_var_declaration(parser);
+    }
+    else if (!parser_match(parser, TOKEN_TYPE_SEMICOLON))
+    {
+        initializer = parser_expression_statement(parser);
+    }
+
+    Expr *condition = NULL;
+    if (!parser_check(parser, TOKEN_TYPE_SEMICOLON))
+    {
+        condition = parser_expression(parser);
+    }
+    parser_consume(parser, TOKEN_TYPE_SEMICOLON, "Expect ';' after loop condition.");
+
+    Expr *increment = NULL;
+    if (!parser_check(parser, TOKEN_TYPE_RIGHT_PAREN))
+    {
+        increment = parser_expression(parser);
+    }
+    parser_consume(parser, TOKEN_TYPE_RIGHT_PAREN, "Expect ')' after for clauses.");
+
+    Stmt *body = parser_statement(parser);
+
+    if (condition == NULL)
+    {
+        condition = arena_alloc(parser->arena, sizeof(Expr));
+        *condition = (Expr){
+            .type = EXPR_TYPE_LITERAL,
+            .as.literal = {
+                .literal = literal_bool(true),
+            },
+        };
+    }
+
+    Stmt *loop = arena_alloc(parser->arena, sizeof(Stmt));
+    *loop = (Stmt){
+        .type = STMT_TYPE_WHILE,
+        .as.whilee = {
+            .condition = condition,
+            .body = body,
+            .increment = increment,
+        },
+    };
+
+    if (initializer == NULL)
+    {
+        return loop;
+    }
+
+    size_t base = parser->scratch_count;
+    parser_scratch_push(parser, initializer);
+    parser_scratch_push(parser, loop);
+
+    Stmt *stmt = arena_alloc(parser->arena, sizeof(Stmt));
+    *stmt = (Stmt){
+        .type = STMT_TYPE_BLOCK,
+        .as.block = {
+            .statements = {
+                .count = 2,
+                .value = (Stmt **)parser_scratch_take(parser, base),
+            },
         },
     };
     return stmt;
@@ -251,30 +343,33 @@ static Stmt *parser_function(Parser *parser)
     Token *name = parser_consume(parser, TOKEN_TYPE_IDENTIFIER, "Expect function name");
     parser_consume(parser, TOKEN_TYPE_LEFT_PAREN, "Expect '(' after function name");
 
-    Token **tokens = malloc(256 * sizeof(Token *));
-    size_t i = 0;
+    size_t base = parser->scratch_count;
     if (!parser_check(parser, TOKEN_TYPE_RIGHT_PAREN))
     {
         do
         {
-            tokens[i++] = parser_consume(parser, TOKEN_TYPE_IDENTIFIER, "Expect parameter name");
+            parser_scratch_push(parser, parser_consume(parser, TOKEN_TYPE_IDENTIFIER, "Expect parameter name"));
         } while (parser_match(parser, TOKEN_TYPE_COMMA));
     }
 
+    size_t params_count = parser->scratch_count - base;
+    Token **params = (Token **)parser_scratch_take(parser, base);
+
     parser_consume(parser, TOKEN_TYPE_RIGHT_PAREN, "Expect ')' after parameters");
     parser_consume(parser, TOKEN_TYPE_LEFT_BRACE, "Expect '{' before body");
     Statements body = parser_block(parser);
 
-    Stmt *stmt = malloc(sizeof(Stmt));
+    Stmt *stmt = arena_alloc(parser->arena, sizeof(Stmt));
     *stmt = (Stmt){
         .type = STMT_TYPE_FUNCTION,
         .as.function = {
             .name = name,
             .params = {
-                .count = i,
-                .value = tokens,
+                .count = params_count,
+                .value = params,
             },
             .body = body,
+            .slot = -1,
         },
     };
     return stmt;
@@ -282,17 +377,16 @@ static Stmt *parser_function(Parser *parser)
 
 static Statements parser_block(Parser *parser)
 {
-    Stmt **statements = malloc(256 * sizeof(Stmt *));
-    size_t i = 0;
+    size_t base = parser->scratch_count;
     while (parser_peek(parser)->type != TOKEN_TYPE_RIGHT_BRACE)
     {
-        statements[i++] = parser_declaration(parser);
+        parser_scratch_push(parser, parser_declaration(parser));
     }
 
     parser_consume(parser, TOKEN_TYPE_RIGHT_BRACE, "Expect '}' after block.");
     return (Statements){
-        .count = i,
-        .value = statements,
+        .count = parser->scratch_count - base,
+        .value = (Stmt **)parser_scratch_take(parser, base),
     };
 }
 
@@ -301,7 +395,7 @@ static Stmt *parser_expression_statement(Parser *parser)
     Expr *expr = parser_expression(parser);
     parser_consume(parser, TOKEN_TYPE_SEMICOLON, "Expect ';' after expression.");
 
-    Stmt *stmt = malloc(sizeof(Stmt));
+    Stmt *stmt = arena_alloc(parser->arena, sizeof(Stmt));
     *stmt = (Stmt){
         .type = STMT_TYPE_EXPRESSION,
         .as.expr = {.expr = expr},
@@ -329,12 +423,13 @@ static Expr *parser_assignment(Parser *parser)
         if (expr->type == EXPR_TYPE_VARIABLE)
         {
             Token *name = expr->as.variable.name;
-            Expr *v_expr = malloc(sizeof(Expr));
+            Expr *v_expr = arena_alloc(parser->arena, sizeof(Expr));
             *v_expr = (Expr){
                 .type = EXPR_TYPE_ASSIGN,
                 .as.assign = {
                     .name = name,
                     .value = value,
+                    .depth = EXPR_DEPTH_GLOBAL,
                 },
             };
             return v_expr;
@@ -359,7 +454,7 @@ static Expr *parser_or(Parser *parser)
         Expr *right_expr = parser_and(parser);
         Expr *left_expr = expr;
 
-        expr = malloc(sizeof(Expr));
+        expr = arena_alloc(parser->arena, sizeof(Expr));
         *expr = (Expr){
             .type = EXPR_TYPE_LOGICAL,
             .as.logical = {
@@ -393,7 +488,7 @@ static Expr *parser_and(Parser *parser)
         Expr *right_expr = parser_equality(parser);
         Expr *left_expr = expr;
 
-        expr = malloc(sizeof(Expr));
+        expr = arena_alloc(parser->arena, sizeof(Expr));
         *expr = (Expr){
             .type = EXPR_TYPE_LOGICAL,
             .as.logical = {
@@ -427,7 +522,7 @@ static Expr *parser_equality(Parser *parser)
         Expr *right_expr = parser_comparison(parser);
         Expr *left_expr = expr;
 
-        expr = malloc(sizeof(Expr));
+        expr = arena_alloc(parser->arena, sizeof(Expr));
         *expr = (Expr){
             .type = EXPR_TYPE_BINARY,
             .as.binary = {
@@ -461,7 +556,7 @@ static Expr *parser_comparison(Parser *parser)
         Expr *right_expr = parser_term(parser);
         Expr *left_expr = expr;
 
-        expr = malloc(sizeof(Expr));
+        expr = arena_alloc(parser->arena, sizeof(Expr));
         *expr = (Expr){
             .type = EXPR_TYPE_BINARY,
             .as.binary = {
@@ -495,7 +590,7 @@ static Expr *parser_term(Parser *parser)
         Expr *right_expr = parser_factor(parser);
         Expr *left_expr = expr;
 
-        expr = malloc(sizeof(Expr));
+        expr = arena_alloc(parser->arena, sizeof(Expr));
         *expr = (Expr){
             .type = EXPR_TYPE_BINARY,
             .as.binary = {
@@ -529,7 +624,7 @@ static Expr *parser_factor(Parser *parser)
         Expr *right_expr = parser_unary(parser);
         Expr *left_expr = expr;
 
-        expr = malloc(sizeof(Expr));
+        expr = arena_alloc(parser->arena, sizeof(Expr));
         *expr = (Expr){
             .type = EXPR_TYPE_BINARY,
             .as.binary = {
@@ -560,7 +655,7 @@ static Expr *parser_unary(Parser *parser)
             return expr;
         }
 
-        Expr *result = malloc(sizeof(Expr));
+        Expr *result = arena_alloc(parser->arena, sizeof(Expr));
         *result = (Expr){
             .type = EXPR_TYPE_UNARY,
             .as.unary = {
@@ -596,26 +691,28 @@ static Expr *parser_call(Parser *parser)
 
 static Expr *parser_finish_callee(Parser *parser, Expr *callee)
 {
-    Expr **expressions = malloc(256 * sizeof(Expr *));
-    size_t i = 0;
+    size_t base = parser->scratch_count;
     if (!parser_check(parser, TOKEN_TYPE_RIGHT_PAREN))
     {
         do
         {
-            expressions[i++] = parser_expression(parser);
+            parser_scratch_push(parser, parser_expression(parser));
         } while (parser_match(parser, TOKEN_TYPE_COMMA));
     }
 
+    size_t arguments_count = parser->scratch_count - base;
+    Expr **arguments = (Expr **)parser_scratch_take(parser, base);
+
     Token *paren = parser_consume(parser, TOKEN_TYPE_RIGHT_PAREN, "Expect ')' after arguments.");
 
-    Expr *expr = malloc(sizeof(Expr));
+    Expr *expr = arena_alloc(parser->arena, sizeof(Expr));
     *expr = (Expr){
         .type = EXPR_TYPE_CALL,
         .as.call = {
             .callee = callee,
             .arguments = {
-                .count = i,
-                .value = expressions,
+                .count = arguments_count,
+                .value = arguments,
             },
             .paren = paren,
         },
@@ -629,71 +726,62 @@ static Expr *parser_primary(Parser *parser)
 
     if (parser_match(parser, TOKEN_TYPE_FALSE))
     {
-        expr = malloc(sizeof(Expr));
+        expr = arena_alloc(parser->arena, sizeof(Expr));
         *expr = (Expr){
             .type = EXPR_TYPE_LITERAL,
             .as.literal = {
-                .literal = {
-                    .type = LITERAL_BOOL,
-                    .value.b = false,
-                },
+                .literal = literal_bool(false),
             },
         };
     }
     else if (parser_match(parser, TOKEN_TYPE_TRUE))
     {
-        expr = malloc(sizeof(Expr));
+        expr = arena_alloc(parser->arena, sizeof(Expr));
         *expr = (Expr){
             .type = EXPR_TYPE_LITERAL,
             .as.literal = {
-                .literal = {
-                    .type = LITERAL_BOOL,
-                    .value.b = true,
-                },
+                .literal = literal_bool(true),
             },
         };
     }
     else if (parser_match(parser, TOKEN_TYPE_NIL))
     {
-        expr = malloc(sizeof(Expr));
+        expr = arena_alloc(parser->arena, sizeof(Expr));
         *expr = (Expr){
             .type = EXPR_TYPE_LITERAL,
             .as.literal = {
-                .literal = {
-                    .type = LITERAL_STRING,
-                    .value.s = NULL,
-                    .is_owned = false,
-                },
+                .literal = literal_none(),
             },
         };
     }
     else if (parser_match(parser, TOKEN_TYPE_STRING))
     {
-        expr = malloc(sizeof(Expr));
+        expr = arena_alloc(parser->arena, sizeof(Expr));
         *expr = (Expr){
             .type = EXPR_TYPE_LITERAL,
             .as.literal = {
-                .literal = parser_previous(parser)->literal,
+                .literal = parser->tokens->literals.value[parser_previous(parser)->literal],
             },
         };
     }
     else if (parser_match(parser, TOKEN_TYPE_NUMBER))
     {
-        expr = malloc(sizeof(Expr));
+        expr = arena_alloc(parser->arena, sizeof(Expr));
         *expr = (Expr){
             .type = EXPR_TYPE_LITERAL,
             .as.literal = {
-                .literal = parser_previous(parser)->literal,
+                .literal = parser->tokens->literals.value[parser_previous(parser)->literal],
             },
         };
     }
     else if (parser_match(parser, TOKEN_TYPE_IDENTIFIER))
     {
-        expr = malloc(sizeof(Expr));
+        expr = arena_alloc(parser->arena, sizeof(Expr));
         *expr = (Expr){
             .type = EXPR_TYPE_VARIABLE,
             .as.variable = {
                 .name = parser_previous(parser),
+                .depth = EXPR_DEPTH_GLOBAL,
             },
         };
     }
@@ -711,7 +799,7 @@ static Expr *parser_primary(Parser *parser)
             return expr_inner;
         }
 
-        expr = malloc(sizeof(Expr));
+        expr = arena_alloc(parser->arena, sizeof(Expr));
         *expr = (Expr){
             .type = EXPR_TYPE_GROUPING,
             .as.grouping = {
@@ -723,3 +811,31 @@ static Expr *parser_primary(Parser *parser)
     parser->had_error = expr == NULL;
     return expr;
 }
+
+static void parser_scratch_push(Parser *parser, void *item)
+{
+    if (parser->scratch_count == parser->scratch_capacity)
+    {
+        parser->scratch_capacity = parser->scratch_capacity < 64 ? 64 : parser->scratch_capacity * 2;
+        parser->scratch = realloc(parser->scratch, parser->scratch_capacity * sizeof(void *));
+    }
+
+    parser->scratch[parser->scratch_count++] = item;
+}
+
+// Child lists are collected on a shared scratch stack while they are parsed,
+// then copied into the arena at their exact size. Nested lists always finish
+// before the enclosing one, so each list owns the top of the stack.
+static void **parser_scratch_take(Parser *parser, size_t base)
+{
+    size_t count = parser->scratch_count - base;
+    parser->scratch_count = base;
+    if (count == 0)
+    {
+        return NULL;
+    }
+
+    void **items = arena_alloc(parser->arena, count * sizeof(void *));
+    memcpy(items, &parser->scratch[base], count * sizeof(void *));
+    return items;
+}
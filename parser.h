@@ -4,16 +4,22 @@
 #include "token.h"
 #include "expr.h"
 #include "stmt.h"
+#include "arena.h"
 #include <stdlib.h>
 
 typedef struct
 {
-    Token *tokens;
+    TokenStream *tokens;
     size_t current;
     bool had_error;
+    Arena *arena;
+    void **scratch;
+    size_t scratch_count;
+    size_t scratch_capacity;
 } Parser;
 
 void parser_init(Parser *parser);
+void parser_free(Parser *parser);
 Statements parser_parse(Parser *parser);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,343 @@
+#include "resolver.h"
+#include <string.h>
+
+typedef struct ResolverScope ResolverScope;
+typedef struct ResolverFunction ResolverFunction;
+
+struct ResolverScope
+{
+    ResolverScope *enclosing;
+    ResolverFunction *function;
+    Token **names;
+    size_t count;
+    size_t capacity;
+};
+
+// `scope` is the innermost scope of the enclosing function at the point of
+// declaration; captured variables are looked up from there.
+struct ResolverFunction
+{
+    ResolverFunction *enclosing;
+    ResolverScope *scope;
+    StmtUpvalue *upvalues;
+    size_t count;
+    size_t capacity;
+};
+
+static ResolverScope *current = NULL;
+static ResolverFunction *function = NULL;
+static Arena *arena = NULL;
+static bool had_error = false;
+
+static void resolver_begin_scope(ResolverScope *scope);
+static size_t resolver_end_scope(void);
+static int resolver_declare(Token *name);
+static int resolver_add(Token *name);
+static void resolver_resolve_local(Token *name, int *depth, int *slot);
+static bool resolver_find(ResolverScope *scope, ResolverFunction *owner, Token *name, int *depth, int *slot);
+static int resolver_resolve_upvalue(ResolverFunction *resolver_function, Token *name);
+static int resolver_add_upvalue(ResolverFunction *resolver_function, bool is_local, int depth, int slot);
+static void resolver_statements(Statements *statements);
+static void resolver_statement(Stmt *stmt);
+static void resolver_expression(Expr *expr);
+static void resolver_visit_block_stmt(StmtBlock *stmt);
+static void resolver_visit_function_stmt(StmtFunction *stmt);
+static void resolver_visit_var_stmt(StmtVar *stmt);
+
+bool resolver_resolve(Statements *statements, Arena *statements_arena)
+{
+    ResolverFunction script = {
+        .enclosing = NULL,
+        .scope = NULL,
+        .upvalues = NULL,
+        .count = 0,
+        .capacity = 0,
+    };
+
+    current = NULL;
+    function = &script;
+    arena = statements_arena;
+    had_error = false;
+    resolver_statements(statements);
+    function = NULL;
+    return !had_error;
+}
+
+static void resolver_begin_scope(ResolverScope *scope)
+{
+    scope->enclosing = current;
+    scope->function = function;
+    scope->names = NULL;
+    scope->count = 0;
+    scope->capacity = 0;
+    current = scope;
+}
+
+static size_t resolver_end_scope(void)
+{
+    size_t count = current->count;
+    free(current->names);
+    current = current->enclosing;
+    return count;
+}
+
+static int resolver_declare(Token *name)
+{
+    if (current == NULL)
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i < current->count; ++i)
+    {
+        if (token_equal(current->names[i], name))
+        {
+            return (int)i;
+        }
+    }
+
+    return resolver_add(name);
+}
+
+static int resolver_add(Token *name)
+{
+    if (current->count == current->capacity)
+    {
+        current->capacity = current->capacity < 8 ? 8 : current->capacity * 2;
+        current->names = realloc(current->names, current->capacity * sizeof(Token *));
+    }
+
+    current->names[current->count] = name;
+    return (int)current->count++;
+}
+
+static void resolver_resolve_local(Token *name, int *depth, int *slot)
+{
+    if (resolver_find(current, function, name, depth, slot))
+    {
+        return;
+    }
+
+    int index = resolver_resolve_upvalue(function, name);
+    if (index >= 0)
+    {
+        *depth = EXPR_DEPTH_UPVALUE;
+        *slot = index;
+        return;
+    }
+
+    *depth = EXPR_DEPTH_GLOBAL;
+    *slot = -1;
+}
+
+static bool resolver_find(ResolverScope *scope, ResolverFunction *owner, Token *name, int *depth, int *slot)
+{
+    int hops = 0;
+    for (; scope != NULL && scope->function == owner; scope = scope->enclosing)
+    {
+        for (size_t i = scope->count; i > 0; --i)
+        {
+            if (token_equal(scope->names[i - 1], name))
+            {
+                *depth = hops;
+                *slot = (int)(i - 1);
+                return true;
+            }
+        }
+
+        hops++;
+    }
+
+    return false;
+}
+
+static int resolver_resolve_upvalue(ResolverFunction *resolver_function, Token *name)
+{
+    if (resolver_function->enclosing == NULL)
+    {
+        return -1;
+    }
+
+    int depth;
+    int slot;
+    if (resolver_find(resolver_function->scope, resolver_function->enclosing, name, &depth, &slot))
+    {
+        return resolver_add_upvalue(resolver_function, true, depth, slot);
+    }
+
+    int index = resolver_resolve_upvalue(resolver_function->enclosing, name);
+    if (index < 0)
+    {
+        return -1;
+    }
+
+    return resolver_add_upvalue(resolver_function, false, 0, index);
+}
+
+static int resolver_add_upvalue(ResolverFunction *resolver_function, bool is_local, int depth, int slot)
+{
+    for (size_t i = 0; i < resolver_function->count; ++i)
+    {
+        StmtUpvalue *upvalue = &resolver_function->upvalues[i];
+        if (upvalue->is_local == is_local && upvalue->depth == depth && upvalue->slot == slot)
+        {
+            return (int)i;
+        }
+    }
+
+    if (resolver_function->count == resolver_function->capacity)
+    {
+        resolver_function->capacity = resolver_function->capacity < 8 ? 8 : resolver_function->capacity * 2;
+        resolver_function->upvalues = realloc(resolver_function->upvalues, resolver_function->capacity * sizeof(StmtUpvalue));
+    }
+
+    resolver_function->upvalues[resolver_function->count] = (StmtUpvalue){
+        .is_local = is_local,
+        .depth = depth,
+        .slot = slot,
+    };
+    return (int)resolver_function->count++;
+}
+
+static void resolver_statements(Statements *statements)
+{
+    for (size_t i = 0; i < statements->count; ++i)
+    {
+        resolver_statement(statements->value[i]);
+    }
+}
+
+static void resolver_statement(Stmt *stmt)
+{
+    switch (stmt->type)
+    {
+    case STMT_TYPE_FUNCTION:
+        resolver_visit_function_stmt(&stmt->as.function);
+        break;
+    case STMT_TYPE_BLOCK:
+        resolver_visit_block_stmt(&stmt->as.block);
+        break;
+    case STMT_TYPE_EXPRESSION:
+        resolver_expression(stmt->as.expr.expr);
+        break;
+    case STMT_TYPE_IF:
+        resolver_expression(stmt->as.iff.condition);
+        resolver_statement(stmt->as.iff.then_branch);
+        if (stmt->as.iff.else_branch != NULL)
+        {
+            resolver_statement(stmt->as.iff.else_branch);
+        }
+        break;
+    case STMT_TYPE_PRINT:
+        resolver_expression(stmt->as.print.value);
+        break;
+    case STMT_TYPE_WHILE:
+        resolver_expression(stmt->as.whilee.condition);
+        resolver_statement(stmt->as.whilee.body);
+        resolver_expression(stmt->as.whilee.increment);
+        break;
+    case STMT_TYPE_VAR:
+        resolver_visit_var_stmt(&stmt->as.var);
+        break;
+    case STMT_TYPE_RETURN:
+        if (stmt->as.returnn.value != NULL)
+        {
+            resolver_expression(stmt->as.returnn.value);
+            stmt->as.returnn.tail = function->enclosing != NULL && stmt->as.returnn.value->type == EXPR_TYPE_CALL;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void resolver_expression(Expr *expr)
+{
+    if (expr == NULL)
+    {
+        return;
+    }
+
+    switch (expr->type)
+    {
+    case EXPR_TYPE_VARIABLE:
+        resolver_resolve_local(expr->as.variable.name, &expr->as.variable.depth, &expr->as.variable.slot);
+        break;
+    case EXPR_TYPE_ASSIGN:
+        resolver_expression(expr->as.assign.value);
+        resolver_resolve_local(expr->as.assign.name, &expr->as.assign.depth, &expr->as.assign.slot);
+        break;
+    case EXPR_TYPE_GROUPING:
+        resolver_expression(expr->as.grouping.expr);
+        break;
+    case EXPR_TYPE_UNARY:
+        resolver_expression(expr->as.unary.expr);
+        break;
+    case EXPR_TYPE_BINARY:
+        resolver_expression(expr->as.binary.left);
+        resolver_expression(expr->as.binary.right);
+        break;
+    case EXPR_TYPE_LOGICAL:
+        resolver_expression(expr->as.logical.left);
+        resolver_expression(expr->as.logical.right);
+        break;
+    case EXPR_TYPE_CALL:
+        resolver_expression(expr->as.call.callee);
+        for (size_t i = 0; i < expr->as.call.arguments.count; ++i)
+        {
+            resolver_expression(expr->as.call.arguments.value[i]);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void resolver_visit_block_stmt(StmtBlock *stmt)
+{
+    ResolverScope scope;
+    resolver_begin_scope(&scope);
+    resolver_statements(&stmt->statements);
+    stmt->slots_count = resolver_end_scope();
+}
+
+static void resolver_visit_function_stmt(StmtFunction *stmt)
+{
+    stmt->slot = resolver_declare(stmt->name);
+
+    ResolverFunction resolver_function = {
+        .enclosing = function,
+        .scope = current,
+        .upvalues = NULL,
+        .count = 0,
+        .capacity = 0,
+    };
+    function = &resolver_function;
+
+    ResolverScope scope;
+    resolver_begin_scope(&scope);
+
+    for (size_t i = 0; i < stmt->params.count; ++i)
+    {
+        resolver_add(stmt->params.value[i]);
+    }
+
+    resolver_statements(&stmt->body);
+    stmt->slots_count = resolver_end_scope();
+
+    stmt->upvalues.count = resolver_function.count;
+    stmt->upvalues.value = NULL;
+    if (resolver_function.count > 0)
+    {
+        stmt->upvalues.value = arena_alloc(arena, resolver_function.count * sizeof(StmtUpvalue));
+        memcpy(stmt->upvalues.value, resolver_function.upvalues, resolver_function.count * sizeof(StmtUpvalue));
+    }
+    free(resolver_function.upvalues);
+    function = resolver_function.enclosing;
+}
+
+static void resolver_visit_var_stmt(StmtVar *stmt)
+{
+    resolver_expression(stmt->initializer);
+    stmt->slot = resolver_declare(stmt->name);
+}
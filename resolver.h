@@ -0,0 +1,10 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "stmt.h"
+#include "arena.h"
+#include <stdbool.h>
+
+bool resolver_resolve(Statements *statements, Arena *arena);
+
+#endif
@@ -4,6 +4,9 @@
 #include <string.h>
 #include "util.h"
 #include "token.h"
+#include "object.h"
+#include "scanner_simd.h"
+#include "number.h"
 
 static void scanner_get_token(Scanner *scanner);
 static void scanner_add_token(Scanner *scanner, enum TokenType token_type, Literal literal);
@@ -14,30 +17,56 @@ static char scanner_advance(Scanner *scanner);
 static bool scanner_is_at_end(Scanner *scanner);
 static bool scanner_is_alpha(char c);
 static bool scanner_is_digit(char c);
-static bool scanner_is_alphanumeric(char c);
-static enum TokenType scanner_reserved_keyword(char *keyword);
+static enum TokenType scanner_reserved_keyword(const char *keyword, size_t length);
+static enum TokenType scanner_check_keyword(const char *keyword, size_t length, const char *reserved, size_t reserved_length, enum TokenType token_type);
 static void scanner_string(Scanner *scanner);
 static void scanner_number(Scanner *scanner);
 static void scanner_identifier(Scanner *scanner);
 
 void scanner_init(Scanner *scanner)
 {
-    scanner->length = strlen(scanner->source);
     scanner->start = 0;
     scanner->current = 0;
-    scanner->tokens_count = 0;
     scanner->line = 1;
+    scanner->tokens = (TokenStream){
+        .count = 0,
+        .capacity = 0,
+        .value = NULL,
+        .literals = {
+            .count = 0,
+            .value = NULL,
+        },
+        .literals_capacity = 0,
+    };
+}
+
+void scanner_free(Scanner *scanner)
+{
+    free(scanner->tokens.value);
+    free(scanner->tokens.literals.value);
+    scanner->tokens.value = NULL;
+    scanner->tokens.literals.value = NULL;
+    scanner->tokens.count = 0;
+    scanner->tokens.literals.count = 0;
 }
 
 void scanner_tokens(Scanner *scanner)
 {
-    while (!scanner_is_at_end(scanner))
+    while (true)
     {
-        scanner_get_token(scanner);
+        scanner->current = scanner_simd_skip_whitespace(scanner->source, scanner->current, scanner->length, &scanner->line);
+        if (scanner_is_at_end(scanner))
+        {
+            break;
+        }
+
         scanner->start = scanner->current;
+        scanner_get_token(scanner);
     }
 
-    scanner_add_token(scanner, TOKEN_TYPE_EOF, (Literal){.type = LITERAL_NONE, .value = {0}});
+    scanner->start = scanner->current;
+
+    scanner_add_token(scanner, TOKEN_TYPE_EOF, literal_none());
 }
 
 static void scanner_get_token(Scanner *scanner)
@@ -47,49 +76,49 @@ static void scanner_get_token(Scanner *scanner)
     switch (c)
     {
     case '(':
-        scanner_add_token(scanner, TOKEN_TYPE_LEFT_PAREN, (Literal){.type = LITERAL_NONE, .value = {0}});
+        scanner_add_token(scanner, TOKEN_TYPE_LEFT_PAREN, literal_none());
         break;
     case ')':
-        scanner_add_token(scanner, TOKEN_TYPE_RIGHT_PAREN, (Literal){.type = LITERAL_NONE, .value = {0}});
+        scanner_add_token(scanner, TOKEN_TYPE_RIGHT_PAREN, literal_none());
         break;
     case '{':
-        scanner_add_token(scanner, TOKEN_TYPE_LEFT_BRACE, (Literal){.type = LITERAL_NONE, .value = {0}});
+        scanner_add_token(scanner, TOKEN_TYPE_LEFT_BRACE, literal_none());
         break;
     case '}':
-        scanner_add_token(scanner, TOKEN_TYPE_RIGHT_BRACE, (Literal){.type = LITERAL_NONE, .value = {0}});
+        scanner_add_token(scanner, TOKEN_TYPE_RIGHT_BRACE, literal_none());
         break;
     case ',':
-        scanner_add_token(scanner, TOKEN_TYPE_COMMA, (Literal){.type = LITERAL_NONE, .value = {0}});
+        scanner_add_token(scanner, TOKEN_TYPE_COMMA, literal_none());
         break;
     case '.':
-        scanner_add_token(scanner, TOKEN_TYPE_DOT, (Literal){.type = LITERAL_NONE, .value = {0}});
+        scanner_add_token(scanner, TOKEN_TYPE_DOT, literal_none());
         break;
     case '-':
-        scanner_add_token(scanner, TOKEN_TYPE_MINUS, (Literal){.type = LITERAL_NONE, .value = {0}});
+        scanner_add_token(scanner, TOKEN_TYPE_MINUS, literal_none());
         break;
     case '+':
-        scanner_add_token(scanner, TOKEN_TYPE_PLUS, (Literal){.type = LITERAL_NONE, .value = {0}});
+        scanner_add_token(scanner, TOKEN_TYPE_PLUS, literal_none());
         break;
     case ';':
-        scanner_add_token(scanner, TOKEN_TYPE_SEMICOLON, (Literal){.type = LITERAL_NONE, .value = {0}});
+        scanner_add_token(scanner, TOKEN_TYPE_SEMICOLON, literal_none());
         break;
     case '*':
-        scanner_add_token(scanner, TOKEN_TYPE_STAR, (Literal){.type = LITERAL_NONE, .value = {0}});
+        scanner_add_token(scanner, TOKEN_TYPE_STAR, literal_none());
         break;
     case '!':
-        scanner_add_token(scanner, scanner_match(scanner, '=') ? TOKEN_TYPE_BANG_EQUAL : TOKEN_TYPE_BANG, (Literal){.type = LITERAL_NONE, .value = {0}});
+        scanner_add_token(scanner, scanner_match(scanner, '=') ? TOKEN_TYPE_BANG_EQUAL : TOKEN_TYPE_BANG, literal_none());
         break;
     case '=':
-        scanner_add_token(scanner, scanner_match(scanner, '=') ? TOKEN_TYPE_EQUAL_EQUAL : TOKEN_TYPE_EQUAL, (Literal){.type = LITERAL_NONE, .value = {0}});
+        scanner_add_token(scanner, scanner_match(scanner, '=') ? TOKEN_TYPE_EQUAL_EQUAL : TOKEN_TYPE_EQUAL, literal_none());
         break;
     case '<':
-        scanner_add_token(scanner, scanner_match(scanner, '=') ? TOKEN_TYPE_LESS_EQUAL : TOKEN_TYPE_LESS, (Literal){.type = LITERAL_NONE, .value = {0}});
+        scanner_add_token(scanner, scanner_match(scanner, '=') ? TOKEN_TYPE_LESS_EQUAL : TOKEN_TYPE_LESS, literal_none());
         break;
     case '>':
-        scanner_add_token(scanner, scanner_match(scanner, '=') ? TOKEN_TYPE_GREATER_EQUAL : TOKEN_TYPE_GREATER, (Literal){.type = LITERAL_NONE, .value = {0}});
+        scanner_add_token(scanner, scanner_match(scanner, '=') ? TOKEN_TYPE_GREATER_EQUAL : TOKEN_TYPE_GREATER, literal_none());
         break;
     case '/':
-        scanner_add_token(scanner, TOKEN_TYPE_SLASH, (Literal){.type = LITERAL_NONE, .value = {0}});
+        scanner_add_token(scanner, TOKEN_TYPE_SLASH, literal_none());
         break;
     case '"':
         scanner_string(scanner);
@@ -122,10 +151,32 @@ static void scanner_get_token(Scanner *scanner)
 
 static void scanner_add_token(Scanner *scanner, enum TokenType token_type, Literal literal)
 {
-    scanner->tokens[scanner->tokens_count++] = (Token){
-        .lexeme = substring(scanner->source, scanner->start, scanner->current),
-        .literal = literal,
-        .type = token_type,
+    TokenStream *tokens = &scanner->tokens;
+    if (tokens->count == tokens->capacity)
+    {
+        tokens->capacity = tokens->capacity < 256 ? 256 : tokens->capacity * 2;
+        tokens->value = realloc(tokens->value, tokens->capacity * sizeof(Token));
+    }
+
+    uint32_t literal_index = TOKEN_NO_LITERAL;
+    if (!literal_is_none(literal))
+    {
+        if (tokens->literals.count == tokens->literals_capacity)
+        {
+            tokens->literals_capacity = tokens->literals_capacity < 64 ? 64 : tokens->literals_capacity * 2;
+            tokens->literals.value = realloc(tokens->literals.value, tokens->literals_capacity * sizeof(Literal));
+        }
+
+        literal_index = (uint32_t)tokens->literals.count;
+        tokens->literals.value[tokens->literals.count++] = literal;
+    }
+
+    tokens->value[tokens->count++] = (Token){
+        .name = token_type == TOKEN_TYPE_IDENTIFIER ? object_copy_string(&scanner->source[scanner->start], scanner->current - scanner->start) : NULL,
+        .offset = (uint32_t)scanner->start,
+        .length = (uint32_t)(scanner->current - scanner->start),
+        .literal = literal_index,
+        .type = (uint8_t)token_type,
     };
 }
 
@@ -183,76 +234,70 @@ static bool scanner_is_digit(char c)
     return (c >= '0' && c <= '9');
 }
 
-static bool scanner_is_alphanumeric(char c)
+// Keywords are told apart by their first one or two characters, so each
+// identifier costs one switch and at most one memcmp.
+static enum TokenType scanner_reserved_keyword(const char *keyword, size_t length)
 {
-    return scanner_is_alpha(c) || scanner_is_digit(c);
+    switch (keyword[0])
+    {
+    case 'a':
+        return scanner_check_keyword(keyword, length, "and", 3, TOKEN_TYPE_AND);
+    case 'c':
+        return scanner_check_keyword(keyword, length, "class", 5, TOKEN_TYPE_CLASS);
+    case 'e':
+        return scanner_check_keyword(keyword, length, "else", 4, TOKEN_TYPE_ELSE);
+    case 'f':
+        if (length > 1)
+        {
+            switch (keyword[1])
+            {
+            case 'a':
+                return scanner_check_keyword(keyword, length, "false", 5, TOKEN_TYPE_FALSE);
+            case 'o':
+                return scanner_check_keyword(keyword, length, "for", 3, TOKEN_TYPE_FOR);
+            case 'u':
+                return scanner_check_keyword(keyword, length, "fun", 3, TOKEN_TYPE_FUN);
+            }
+        }
+        break;
+    case 'i':
+        return scanner_check_keyword(keyword, length, "if", 2, TOKEN_TYPE_IF);
+    case 'n':
+        return scanner_check_keyword(keyword, length, "nil", 3, TOKEN_TYPE_NIL);
+    case 'o':
+        return scanner_check_keyword(keyword, length, "or", 2, TOKEN_TYPE_OR);
+    case 'p':
+        return scanner_check_keyword(keyword, length, "print", 5, TOKEN_TYPE_PRINT);
+    case 'r':
+        return scanner_check_keyword(keyword, length, "return", 6, TOKEN_TYPE_RETURN);
+    case 's':
+        return scanner_check_keyword(keyword, length, "super", 5, TOKEN_TYPE_SUPER);
+    case 't':
+        if (length > 1)
+        {
+            switch (keyword[1])
+            {
+            case 'h':
+                return scanner_check_keyword(keyword, length, "this", 4, TOKEN_TYPE_THIS);
+            case 'r':
+                return scanner_check_keyword(keyword, length, "true", 4, TOKEN_TYPE_TRUE);
+            }
+        }
+        break;
+    case 'v':
+        return scanner_check_keyword(keyword, length, "var", 3, TOKEN_TYPE_VAR);
+    case 'w':
+        return scanner_check_keyword(keyword, length, "while", 5, TOKEN_TYPE_WHILE);
+    }
+
+    return TOKEN_TYPE_NONE;
 }
 
-static enum TokenType scanner_reserved_keyword(char *keyword)
+static enum TokenType scanner_check_keyword(const char *keyword, size_t length, const char *reserved, size_t reserved_length, enum TokenType token_type)
 {
-    if (strcmp(keyword, "and") == 0)
-    {
-        return TOKEN_TYPE_AND;
-    }
-    if (strcmp(keyword, "class") == 0)
-    {
-        return TOKEN_TYPE_CLASS;
-    }
-    if (strcmp(keyword, "else") == 0)
-    {
-        return TOKEN_TYPE_ELSE;
-    }
-    if (strcmp(keyword, "false") == 0)
-    {
-        return TOKEN_TYPE_FALSE;
-    }
-    if (strcmp(keyword, "for") == 0)
-    {
-        return TOKEN_TYPE_FOR;
-    }
-    if (strcmp(keyword, "fun") == 0)
-    {
-        return TOKEN_TYPE_FUN;
-    }
-    if (strcmp(keyword, "if") == 0)
-    {
-        return TOKEN_TYPE_IF;
-    }
-    if (strcmp(keyword, "nil") == 0)
-    {
-        return TOKEN_TYPE_NIL;
-    }
-    if (strcmp(keyword, "or") == 0)
-    {
-        return TOKEN_TYPE_OR;
-    }
-    if (strcmp(keyword, "print") == 0)
-    {
-        return TOKEN_TYPE_PRINT;
-    }
-    if (strcmp(keyword, "return") == 0)
-    {
-        return TOKEN_TYPE_RETURN;
-    }
-    if (strcmp(keyword, "super") == 0)
-    {
-        return TOKEN_TYPE_SUPER;
-    }
-    if (strcmp(keyword, "this") == 0)
-    {
-        return TOKEN_TYPE_THIS;
-    }
-    if (strcmp(keyword, "true") == 0)
-    {
-        return TOKEN_TYPE_TRUE;
-    }
-    if (strcmp(keyword, "var") == 0)
-    {
-        return TOKEN_TYPE_VAR;
-    }
-    if (strcmp(keyword, "while") == 0)
+    if (length == reserved_length && memcmp(keyword, reserved, length) == 0)
     {
-        return TOKEN_TYPE_WHILE;
+        return token_type;
     }
 
     return TOKEN_TYPE_NONE;
@@ -260,61 +305,45 @@ static enum TokenType scanner_reserved_keyword(char *keyword)
 
 static void scanner_string(Scanner *scanner)
 {
-    while (scanner_peek(scanner) != '"')
+    scanner->current = scanner_simd_find_quote(scanner->source, scanner->current, scanner->length, &scanner->line);
+
+    if (scanner_is_at_end(scanner))
     {
-        scanner_advance(scanner);
+        fprintf(stderr, "Unterminated string.\n");
+        return;
     }
 
     scanner_advance(scanner);
 
-    char *value = substring(scanner->source, scanner->start + 1, scanner->current - 1);
+    Literal value = literal_copy_string(&scanner->source[scanner->start + 1], scanner->current - scanner->start - 2);
 
-    scanner_add_token(scanner, TOKEN_TYPE_STRING, (Literal){.type = LITERAL_STRING, .value.s = value});
+    scanner_add_token(scanner, TOKEN_TYPE_STRING, value);
 }
 
 static void scanner_number(Scanner *scanner)
 {
-    while (scanner_is_digit(scanner_peek(scanner)))
-    {
-        scanner_advance(scanner);
-    }
+    scanner->current = scanner_simd_skip_digits(scanner->source, scanner->current, scanner->length);
 
     if (scanner_peek(scanner) == '.' && scanner_is_digit(scanner_peek_next(scanner)))
     {
         scanner_advance(scanner);
-
-        while (scanner_is_digit(scanner_peek(scanner)))
-        {
-            scanner_advance(scanner);
-        }
+        scanner->current = scanner_simd_skip_digits(scanner->source, scanner->current, scanner->length);
     }
 
-    char *lexeme = substring(scanner->source, scanner->start, scanner->current);
-    char *endptr;
-    double value = strtod(lexeme, &endptr);
+    double value = number_parse(&scanner->source[scanner->start], scanner->current - scanner->start);
 
-    free(lexeme);
-
-    scanner_add_token(scanner, TOKEN_TYPE_NUMBER, (Literal){.type = LITERAL_NUMBER, .value.i = value});
+    scanner_add_token(scanner, TOKEN_TYPE_NUMBER, literal_number(value));
 }
 
 static void scanner_identifier(Scanner *scanner)
 {
-    while (scanner_is_alphanumeric(scanner_peek(scanner)))
-    {
-        scanner_advance(scanner);
-    }
+    scanner->current = scanner_simd_skip_identifier(scanner->source, scanner->current, scanner->length);
 
-    char *value = substring(scanner->source, scanner->start, scanner->current);
-    enum TokenType token_type = scanner_reserved_keyword(value);
+    enum TokenType token_type = scanner_reserved_keyword(&scanner->source[scanner->start], scanner->current - scanner->start);
     if (token_type == TOKEN_TYPE_NONE)
     {
         token_type = TOKEN_TYPE_IDENTIFIER;
     }
 
-    scanner_add_token(scanner, token_type, (Literal){
-                                               .type = LITERAL_STRING,
-                                               .value.s = value,
-                                               .is_owned = false,
-                                           });
+    scanner_add_token(scanner, token_type, literal_none());
 }
\ No newline at end of file
@@ -5,12 +5,9 @@
 #include <stdbool.h>
 #include "token.h"
 
-#define MAX_TOKENS 256
-
 typedef struct
 {
-    Token tokens[MAX_TOKENS];
-    size_t tokens_count;
+    TokenStream tokens;
     const char *source;
     size_t length;
     size_t start;
@@ -20,5 +17,6 @@ typedef struct
 
 void scanner_init(Scanner *scanner);
 void scanner_tokens(Scanner *scanner);
+void scanner_free(Scanner *scanner);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "scanner_simd.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCANNER_SIMD_WIDTH 32
+typedef __m256i Vector;
+typedef uint32_t Mask;
+#define VECTOR_LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+#define VECTOR_SPLAT(c) _mm256_set1_epi8((char)(c))
+#define VECTOR_EQ(a, b) _mm256_cmpeq_epi8((a), (b))
+#define VECTOR_GT(a, b) _mm256_cmpgt_epi8((a), (b))
+#define VECTOR_OR(a, b) _mm256_or_si256((a), (b))
+#define VECTOR_AND(a, b) _mm256_and_si256((a), (b))
+#define VECTOR_MASK(v) ((Mask)_mm256_movemask_epi8(v))
+#define MASK_ALL ((Mask)0xffffffff)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SCANNER_SIMD_WIDTH 16
+typedef __m128i Vector;
+typedef uint32_t Mask;
+#define VECTOR_LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+#define VECTOR_SPLAT(c) _mm_set1_epi8((char)(c))
+#define VECTOR_EQ(a, b) _mm_cmpeq_epi8((a), (b))
+#define VECTOR_GT(a, b) _mm_cmpgt_epi8((a), (b))
+#define VECTOR_OR(a, b) _mm_or_si128((a), (b))
+#define VECTOR_AND(a, b) _mm_and_si128((a), (b))
+#define VECTOR_MASK(v) ((Mask)_mm_movemask_epi8(v))
+#define MASK_ALL ((Mask)0xffff)
+#endif
+
+static bool scanner_simd_is_whitespace(char c);
+static bool scanner_simd_is_identifier(char c);
+static bool scanner_simd_is_digit(char c);
+
+#ifdef SCANNER_SIMD_WIDTH
+
+// Byte comparisons are signed, so anything outside ASCII compares below
+// every range used here and is never classified as a word or digit byte.
+static inline Vector scanner_simd_in_range(Vector v, char low, char high)
+{
+    return VECTOR_AND(VECTOR_GT(v, VECTOR_SPLAT(low - 1)), VECTOR_GT(VECTOR_SPLAT(high + 1), v));
+}
+
+static inline Mask scanner_simd_prefix(Mask mask, unsigned count)
+{
+    return count >= 32 ? mask : mask & (((Mask)1 << count) - 1);
+}
+
+#endif
+
+size_t scanner_simd_skip_whitespace(const char *source, size_t current, size_t length, size_t *lines)
+{
+#ifdef SCANNER_SIMD_WIDTH
+    while (current + SCANNER_SIMD_WIDTH <= length)
+    {
+        Vector v = VECTOR_LOAD(&source[current]);
+        Vector newline = VECTOR_EQ(v, VECTOR_SPLAT('\n'));
+        Vector space = VECTOR_OR(VECTOR_OR(VECTOR_EQ(v, VECTOR_SPLAT(' ')), VECTOR_EQ(v, VECTOR_SPLAT('\t'))),
+                                 VECTOR_OR(VECTOR_EQ(v, VECTOR_SPLAT('\r')), newline));
+
+        Mask other = ~VECTOR_MASK(space) & MASK_ALL;
+        unsigned skipped = other == 0 ? SCANNER_SIMD_WIDTH : (unsigned)__builtin_ctz(other);
+        *lines += (size_t)__builtin_popcount(scanner_simd_prefix(VECTOR_MASK(newline), skipped));
+        current += skipped;
+
+        if (other != 0)
+        {
+            return current;
+        }
+    }
+#endif
+
+    while (current < length && scanner_simd_is_whitespace(source[current]))
+    {
+        if (source[current] == '\n')
+        {
+            (*lines)++;
+        }
+        current++;
+    }
+
+    return current;
+}
+
+size_t scanner_simd_skip_identifier(const char *source, size_t current, size_t length)
+{
+#ifdef SCANNER_SIMD_WIDTH
+    while (current + SCANNER_SIMD_WIDTH <= length)
+    {
+        Vector v = VECTOR_LOAD(&source[current]);
+        Vector lower = VECTOR_OR(v, VECTOR_SPLAT(0x20));
+        Vector word = VECTOR_OR(VECTOR_OR(scanner_simd_in_range(lower, 'a', 'z'), scanner_simd_in_range(v, '0', '9')),
+                                VECTOR_EQ(v, VECTOR_SPLAT('_')));
+
+        Mask other = ~VECTOR_MASK(word) & MASK_ALL;
+        if (other != 0)
+        {
+            return current + (size_t)__builtin_ctz(other);
+        }
+        current += SCANNER_SIMD_WIDTH;
+    }
+#endif
+
+    while (current < length && scanner_simd_is_identifier(source[current]))
+    {
+        current++;
+    }
+
+    return current;
+}
+
+size_t scanner_simd_skip_digits(const char *source, size_t current, size_t length)
+{
+#ifdef SCANNER_SIMD_WIDTH
+    while (current + SCANNER_SIMD_WIDTH <= length)
+    {
+        Vector v = VECTOR_LOAD(&source[current]);
+        Mask other = ~VECTOR_MASK(scanner_simd_in_range(v, '0', '9')) & MASK_ALL;
+        if (other != 0)
+        {
+            return current + (size_t)__builtin_ctz(other);
+        }
+        current += SCANNER_SIMD_WIDTH;
+    }
+#endif
+
+    while (current < length && scanner_simd_is_digit(source[current]))
+    {
+        current++;
+    }
+
+    return current;
+}
+
+size_t scanner_simd_find_quote(const char *source, size_t current, size_t length, size_t *lines)
+{
+#ifdef SCANNER_SIMD_WIDTH
+    while (current + SCANNER_SIMD_WIDTH <= length)
+    {
+        Vector v = VECTOR_LOAD(&source[current]);
+        Mask quote = VECTOR_MASK(VECTOR_EQ(v, VECTOR_SPLAT('"')));
+        Mask newline = VECTOR_MASK(VECTOR_EQ(v, VECTOR_SPLAT('\n')));
+
+        unsigned skipped = quote == 0 ? SCANNER_SIMD_WIDTH : (unsigned)__builtin_ctz(quote);
+        *lines += (size_t)__builtin_popcount(scanner_simd_prefix(newline, skipped));
+        current += skipped;
+
+        if (quote != 0)
+        {
+            return current;
+        }
+    }
+#endif
+
+    while (current < length && source[current] != '"')
+    {
+        if (source[current] == '\n')
+        {
+            (*lines)++;
+        }
+        current++;
+    }
+
+    return current;
+}
+
+static bool scanner_simd_is_whitespace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool scanner_simd_is_identifier(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static bool scanner_simd_is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
@@ -0,0 +1,11 @@
+#ifndef SCANNER_SIMD_H
+#define SCANNER_SIMD_H
+
+#include <stdlib.h>
+
+size_t scanner_simd_skip_whitespace(const char *source, size_t current, size_t length, size_t *lines);
+size_t scanner_simd_skip_identifier(const char *source, size_t current, size_t length);
+size_t scanner_simd_skip_digits(const char *source, size_t current, size_t length);
+size_t scanner_simd_find_quote(const char *source, size_t current, size_t length, size_t *lines);
+
+#endif
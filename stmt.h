@@ -1,10 +1,16 @@
 #ifndef STMT_H
 #define STMT_H
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include "expr.h"
 
 typedef struct Stmt Stmt;
+typedef struct StmtFunction StmtFunction;
+typedef struct InterpreterResult InterpreterResult;
+
+// See ExprEvaluate.
+typedef InterpreterResult (*StmtExecute)(Stmt *stmt);
 
 typedef enum
 {
@@ -36,21 +42,28 @@ typedef struct
     Expr *value;
 } StmtPrint;
 
+// `tail` is set by the resolver when a function returns the result of a
+// call, which then runs in place of the returning function's frame.
 typedef struct
 {
     Token *keyword;
     Expr *value;
+    bool tail;
 } StmtReturn;
 
+// `for` loops become a while loop with the increment kept apart, run after
+// the body, inside a block holding the initializer.
 typedef struct
 {
     Expr *condition;
     Stmt *body;
+    Expr *increment;
 } StmtWhile;
 
 typedef struct
 {
     Statements statements;
+    size_t slots_count;
 } StmtBlock;
 
 typedef struct
@@ -62,17 +75,38 @@ typedef struct
 {
     Token *name;
     Expr *initializer;
+    int slot;
 } StmtVar;
 
+// A variable captured by a function. Local captures name a slot in the
+// frames of the enclosing function, `depth` hops out from the declaration;
+// the others reuse the enclosing function's upvalue at index `slot`.
+typedef struct
+{
+    bool is_local;
+    int depth;
+    int slot;
+} StmtUpvalue;
+
+typedef struct
+{
+    size_t count;
+    StmtUpvalue *value;
+} StmtUpvalues;
+
 struct StmtFunction
 {
     Token *name;
     Tokens params;
     Statements body;
+    int slot;
+    size_t slots_count;
+    StmtUpvalues upvalues;
 };
 
 struct Stmt
 {
+    StmtExecute execute;
     StmtType type;
     union
     {
@@ -0,0 +1,204 @@
+#include "table.h"
+#include "memory.h"
+#include <string.h>
+
+#define TABLE_MAX_LOAD 0.75
+#define TABLE_FNV_OFFSET_BASIS 2166136261u
+
+static TableEntry *table_find_entry(TableEntry *entries, size_t capacity, ObjectString *key);
+static void table_grow(Table *table);
+
+void table_init(Table *table)
+{
+    table->count = 0;
+    table->capacity = 0;
+    table->entries = NULL;
+}
+
+void table_free(Table *table)
+{
+    free(table->entries);
+    table_init(table);
+}
+
+Literal *table_get(Table *table, ObjectString *key)
+{
+    if (table->count == 0)
+    {
+        return NULL;
+    }
+
+    TableEntry *entry = table_find_entry(table->entries, table->capacity, key);
+    if (entry->key == NULL)
+    {
+        return NULL;
+    }
+
+    return &entry->value;
+}
+
+bool table_set(Table *table, ObjectString *key, Literal value)
+{
+    if (table->count + 1 > table->capacity * TABLE_MAX_LOAD)
+    {
+        table_grow(table);
+    }
+
+    TableEntry *entry = table_find_entry(table->entries, table->capacity, key);
+    bool is_new = entry->key == NULL;
+    if (is_new && literal_is_none(entry->value))
+    {
+        table->count++;
+    }
+
+    entry->key = key;
+    entry->value = value;
+    return is_new;
+}
+
+bool table_delete(Table *table, ObjectString *key)
+{
+    if (table->count == 0)
+    {
+        return false;
+    }
+
+    TableEntry *entry = table_find_entry(table->entries, table->capacity, key);
+    if (entry->key == NULL)
+    {
+        return false;
+    }
+
+    // Leave a tombstone so probe sequences running through this slot still
+    // reach the entries behind it.
+    entry->key = NULL;
+    entry->value = literal_bool(true);
+    return true;
+}
+
+ObjectString *table_find_string(Table *table, const char *chars, size_t length, uint32_t hash)
+{
+    if (table->count == 0)
+    {
+        return NULL;
+    }
+
+    size_t index = hash & (table->capacity - 1);
+    while (true)
+    {
+        TableEntry *entry = &table->entries[index];
+        if (entry->key == NULL)
+        {
+            if (literal_is_none(entry->value))
+            {
+                return NULL;
+            }
+        }
+        else if (entry->key->hash == hash && entry->key->length == length && memcmp(entry->key->chars, chars, length) == 0)
+        {
+            return entry->key;
+        }
+
+        index = (index + 1) & (table->capacity - 1);
+    }
+}
+
+uint32_t table_hash(const char *key, size_t length)
+{
+    return table_hash_extend(TABLE_FNV_OFFSET_BASIS, key, length);
+}
+
+uint32_t table_hash_extend(uint32_t hash, const char *key, size_t length)
+{
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash ^= (uint8_t)key[i];
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+void table_mark(Table *table)
+{
+    for (size_t i = 0; i < table->capacity; ++i)
+    {
+        if (table->entries[i].key != NULL)
+        {
+            memory_mark_object((Object *)table->entries[i].key);
+            memory_mark_literal(table->entries[i].value);
+        }
+    }
+}
+
+void table_remove_unmarked(Table *table)
+{
+    for (size_t i = 0; i < table->capacity; ++i)
+    {
+        TableEntry *entry = &table->entries[i];
+        if (entry->key != NULL && !entry->key->object.is_marked)
+        {
+            table_delete(table, entry->key);
+        }
+    }
+}
+
+static TableEntry *table_find_entry(TableEntry *entries, size_t capacity, ObjectString *key)
+{
+    // Keys are interned, so identity is equality and the hash cached on the
+    // string picks the bucket.
+    TableEntry *tombstone = NULL;
+    size_t index = key->hash & (capacity - 1);
+    while (true)
+    {
+        TableEntry *entry = &entries[index];
+        if (entry->key == key)
+        {
+            return entry;
+        }
+
+        if (entry->key == NULL)
+        {
+            if (literal_is_none(entry->value))
+            {
+                return tombstone != NULL ? tombstone : entry;
+            }
+
+            if (tombstone == NULL)
+            {
+                tombstone = entry;
+            }
+        }
+
+        index = (index + 1) & (capacity - 1);
+    }
+}
+
+static void table_grow(Table *table)
+{
+    size_t capacity = table->capacity < 8 ? 8 : table->capacity * 2;
+    TableEntry *entries = malloc(capacity * sizeof(TableEntry));
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        entries[i] = (TableEntry){
+            .key = NULL,
+            .value = literal_none(),
+        };
+    }
+
+    table->count = 0;
+    for (size_t i = 0; i < table->capacity; ++i)
+    {
+        TableEntry *entry = &table->entries[i];
+        if (entry->key == NULL)
+        {
+            continue;
+        }
+
+        *table_find_entry(entries, capacity, entry->key) = *entry;
+        table->count++;
+    }
+
+    free(table->entries);
+    table->entries = entries;
+    table->capacity = capacity;
+}
@@ -0,0 +1,34 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include "literal.h"
+#include "object.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef struct
+{
+    ObjectString *key;
+    Literal value;
+} TableEntry;
+
+typedef struct
+{
+    size_t count;
+    size_t capacity;
+    TableEntry *entries;
+} Table;
+
+void table_init(Table *table);
+void table_free(Table *table);
+Literal *table_get(Table *table, ObjectString *key);
+bool table_set(Table *table, ObjectString *key, Literal value);
+bool table_delete(Table *table, ObjectString *key);
+ObjectString *table_find_string(Table *table, const char *chars, size_t length, uint32_t hash);
+uint32_t table_hash(const char *key, size_t length);
+uint32_t table_hash_extend(uint32_t hash, const char *key, size_t length);
+void table_mark(Table *table);
+void table_remove_unmarked(Table *table);
+
+#endif
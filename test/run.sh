@@ -0,0 +1,23 @@
+#!/bin/sh
+# Runs every script in test/ on both engines and compares its output and
+# exit status with the matching .expected file. A .tree.expected or
+# .vm.expected file takes precedence for that engine.
+lox=${1:-./lox}
+failed=0
+
+for script in test/*.lox; do
+    for engine in tree vm; do
+        expected="${script%.lox}.$engine.expected"
+        if [ ! -f "$expected" ]; then
+            expected="${script%.lox}.expected"
+        fi
+
+        actual=$("$lox" --engine=$engine "$script" 2>/dev/null; echo "exit $?")
+        if [ "$actual" != "$(cat "$expected")" ]; then
+            echo "FAIL $script ($engine)"
+            failed=1
+        fi
+    done
+done
+
+exit $failed
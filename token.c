@@ -1,40 +1,43 @@
 #include "token.h"
+#include "object.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
-void token_free(Token *token)
+bool token_equal(Token *left, Token *right)
 {
-    if (token->lexeme != NULL)
-    {
-        free(token->lexeme);
-    }
-
-    if (token->literal.type == LITERAL_STRING && token->literal.value.s != NULL)
-    {
-        free(token->literal.value.s);
-    }
+    return left->name == right->name;
 }
 
-void token_print_string(Token *token)
+void token_print_string(Token *token, Literals *literals)
 {
-    char *text = "";
+    const char *text = "";
+    size_t length = 0;
     char str_buffer[32];
 
-    switch (token->literal.type)
+    Literal literal = token->literal == TOKEN_NO_LITERAL ? literal_none() : literals->value[token->literal];
+    if (token->name != NULL)
+    {
+        literal = literal_string(token->name);
+    }
+
+    switch (literal_type(literal))
     {
     case LITERAL_STRING:
-        text = token->literal.value.s;
+        text = literal_string_chars(&literal);
+        length = literal_string_length(literal);
         break;
     case LITERAL_NUMBER:
-        snprintf(str_buffer, 32, "%.4f", token->literal.value.i);
+        length = (size_t)snprintf(str_buffer, 32, "%.4f", literal_as_number(literal));
         text = str_buffer;
         break;
     case LITERAL_BOOL:
-        text = token->literal.value.b ? "true" : "false";
+        text = literal_as_bool(literal) ? "true" : "false";
+        length = strlen(text);
         break;
     default:
         break;
     }
 
-    fprintf(stdout, "%s %s %s\n", token_type_get_name(&token->type), token->lexeme, text);
+    fprintf(stdout, "%s %.*s\n", token_type_get_name(token->type), (int)length, text);
 }
\ No newline at end of file
@@ -2,50 +2,30 @@
 #define TOKEN_H
 
 #include "token_type.h"
+#include "literal.h"
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
-typedef struct StmtFunction StmtFunction;
-
-typedef enum
-{
-    LITERAL_STRING,
-    LITERAL_NUMBER,
-    LITERAL_BOOL,
-    LITERAL_FUNCTION,
-    LITERAL_NONE
-} LiteralType;
-
-typedef struct
-{
-    struct StmtFunction *stmt;
-    void *f;
-} LiteralFunction;
-
-typedef struct
-{
-    LiteralType type;
-    union
-    {
-        char *s;
-        double i;
-        bool b;
-        LiteralFunction f;
-    } value;
-    bool is_owned;
-} Literal;
-
 typedef struct
 {
     size_t count;
     Literal *value;
 } Literals;
 
+#define TOKEN_NO_LITERAL UINT32_MAX
+
+// Literal values live in a side table so the token itself stays small;
+// `literal` indexes it for number and string tokens. Identifiers carry their
+// interned name, and `offset`/`length` locate every token's lexeme in the
+// source for diagnostics.
 typedef struct
 {
-    enum TokenType type;
-    char *lexeme;
-    Literal literal;
+    ObjectString *name;
+    uint32_t offset;
+    uint32_t length;
+    uint32_t literal;
+    uint8_t type;
 } Token;
 
 typedef struct
@@ -54,7 +34,16 @@ typedef struct
     Token **value;
 } Tokens;
 
-void token_free(Token *token);
-void token_print_string(Token *token);
+typedef struct
+{
+    size_t count;
+    size_t capacity;
+    Token *value;
+    Literals literals;
+    size_t literals_capacity;
+} TokenStream;
+
+bool token_equal(Token *left, Token *right);
+void token_print_string(Token *token, Literals *literals);
 
 #endif
\ No newline at end of file
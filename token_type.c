@@ -2,11 +2,11 @@
 #include <stdlib.h>
 #include <stdio.h>
 
-char *token_type_get_name(enum TokenType *token_type)
+char *token_type_get_name(enum TokenType token_type)
 {
-    // printf("%d\n", *token_type);
+    // printf("%d\n", token_type);
 
-    switch (*token_type)
+    switch (token_type)
     {
     case TOKEN_TYPE_LEFT_PAREN:
         return "(";
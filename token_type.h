@@ -54,6 +54,6 @@ enum TokenType
     TOKEN_TYPE_EOF
 };
 
-char *token_type_get_name(enum TokenType *token_type);
+char *token_type_get_name(enum TokenType token_type);
 
 #endif
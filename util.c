@@ -2,23 +2,113 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-char *util_read_file(const char *filename)
+static bool util_read_stream(int fd, SourceFile *file);
+
+// Regular files are mapped read-only and paged in as the scanner walks
+// them. The scanner is bounded by length, so no terminating NUL is needed.
+bool util_open_source(const char *filename, SourceFile *file)
 {
-    FILE *file = fopen(filename, "r");
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
 
-    fseek(file, 0, SEEK_END);
-    long length = ftell(file);
-    rewind(file);
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        close(fd);
+        return false;
+    }
 
-    char *buffer = malloc(length + 1);
+    if (!S_ISREG(st.st_mode))
+    {
+        bool ok = util_read_stream(fd, file);
+        close(fd);
+        return ok;
+    }
 
-    size_t bytes = fread(buffer, sizeof(*buffer), length, file);
-    buffer[bytes] = '\0';
+    file->length = (size_t)st.st_size;
+    file->is_mapped = file->length > 0;
+    file->data = "";
 
-    fclose(file);
+    if (file->is_mapped)
+    {
+        void *data = mmap(NULL, file->length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            close(fd);
+            return false;
+        }
 
-    return buffer;
+        madvise(data, file->length, MADV_SEQUENTIAL);
+        file->data = data;
+    }
+
+    close(fd);
+    return true;
+}
+
+void util_close_source(SourceFile *file)
+{
+    if (file->is_mapped)
+    {
+        munmap((void *)file->data, file->length);
+    }
+    else if (file->length > 0)
+    {
+        free((void *)file->data);
+    }
+
+    file->data = NULL;
+    file->length = 0;
+    file->is_mapped = false;
+}
+
+static bool util_read_stream(int fd, SourceFile *file)
+{
+    size_t capacity = 4096;
+    size_t length = 0;
+    char *buffer = malloc(capacity);
+
+    while (true)
+    {
+        if (length == capacity)
+        {
+            capacity *= 2;
+            buffer = realloc(buffer, capacity);
+        }
+
+        ssize_t bytes = read(fd, buffer + length, capacity - length);
+        if (bytes < 0)
+        {
+            free(buffer);
+            return false;
+        }
+
+        if (bytes == 0)
+        {
+            break;
+        }
+
+        length += (size_t)bytes;
+    }
+
+    file->data = buffer;
+    file->length = length;
+    file->is_mapped = false;
+    if (length == 0)
+    {
+        free(buffer);
+        file->data = "";
+    }
+
+    return true;
 }
 
 char *substring(const char *source, size_t start_index, size_t end_index)
@@ -1,9 +1,18 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <stdbool.h>
 #include <stdio.h>
 
-char *util_read_file(const char *filename);
+typedef struct
+{
+    const char *data;
+    size_t length;
+    bool is_mapped;
+} SourceFile;
+
+bool util_open_source(const char *filename, SourceFile *file);
+void util_close_source(SourceFile *file);
 char *substring(const char *source, size_t start_index, size_t end_index);
 int imin(int a, int b);
 int imax(int a, int b);
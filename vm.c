@@ -0,0 +1,510 @@
+#include "vm.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "table.h"
+#include "memory.h"
+#include "object.h"
+
+#define VM_FRAMES_INITIAL 64
+#define VM_STACK_INITIAL (VM_FRAMES_INITIAL * 256)
+#define VM_TRACE_MAX 16
+
+typedef struct
+{
+    CompiledFunction *function;
+    ObjectClosure *closure;
+    uint8_t *ip;
+    Literal *slots;
+} CallFrame;
+
+typedef struct
+{
+    CallFrame *frames;
+    size_t frames_count;
+    size_t frames_capacity;
+    size_t max_depth;
+    Literal *stack;
+    Literal *stack_top;
+    size_t stack_capacity;
+    ObjectUpvalue *open_upvalues;
+    Table globals;
+} Vm;
+
+static Vm vm;
+
+static VmResult vm_run(void);
+static void vm_runtime_error(const char *format, ...);
+static void vm_push(Literal literal);
+static Literal vm_pop(void);
+static Literal vm_peek(size_t distance);
+static bool vm_call(Literal callee, size_t arguments_count);
+static void vm_grow_stack(size_t needed);
+static ObjectUpvalue *vm_capture_upvalue(Literal *local);
+static void vm_close_upvalues(Literal *last);
+static void vm_mark_roots(void);
+
+VmResult vm_interpret(CompiledFunction *function, size_t max_depth)
+{
+    // Frames and stack live on the heap and grow on demand up to max_depth
+    // frames, so deep recursion costs only what it uses.
+    vm.frames_capacity = VM_FRAMES_INITIAL < max_depth ? VM_FRAMES_INITIAL : max_depth;
+    vm.frames = malloc(vm.frames_capacity * sizeof(CallFrame));
+    vm.frames_count = 0;
+    vm.open_upvalues = NULL;
+    vm.max_depth = max_depth;
+    vm.stack_capacity = VM_STACK_INITIAL;
+    vm.stack = malloc(vm.stack_capacity * sizeof(Literal));
+    vm.stack_top = vm.stack;
+    table_init(&vm.globals);
+    memory_set_roots(vm_mark_roots);
+
+    Literal script = literal_compiled_function(function);
+    vm_push(script);
+    VmResult result = vm_call(script, 0) ? vm_run() : VM_RESULT_RUNTIME_ERROR;
+
+    free(vm.frames);
+    free(vm.stack);
+    table_free(&vm.globals);
+    vm.frames = NULL;
+    vm.stack = NULL;
+    vm.stack_top = NULL;
+    return result;
+}
+
+static VmResult vm_run(void)
+{
+    CallFrame *frame = &vm.frames[vm.frames_count - 1];
+    uint8_t *ip = frame->ip;
+
+#define READ_BYTE() (*ip++)
+#define READ_SHORT() (ip += 2, (uint16_t)((ip[-2] << 8) | ip[-1]))
+#define READ_CONSTANT() (frame->function->chunk.constants.value[READ_SHORT()])
+#define READ_NAME() (frame->function->chunk.names.value[READ_SHORT()])
+
+    while (true)
+    {
+        switch (READ_BYTE())
+        {
+        case OP_CODE_CONSTANT:
+            vm_push(READ_CONSTANT());
+            break;
+        case OP_CODE_NONE:
+            vm_push(literal_none());
+            break;
+        case OP_CODE_TRUE:
+            vm_push(literal_bool(true));
+            break;
+        case OP_CODE_FALSE:
+            vm_push(literal_bool(false));
+            break;
+        case OP_CODE_POP:
+            vm_pop();
+            break;
+        case OP_CODE_GET_LOCAL:
+            vm_push(frame->slots[READ_BYTE()]);
+            break;
+        case OP_CODE_SET_LOCAL:
+            frame->slots[READ_BYTE()] = vm_peek(0);
+            break;
+        case OP_CODE_GET_GLOBAL:
+        {
+            Token *name = READ_NAME();
+            Literal *value = table_get(&vm.globals, name->name);
+            if (value == NULL)
+            {
+                vm_runtime_error("Undefined variable '%s'.", name->name->chars);
+                return VM_RESULT_RUNTIME_ERROR;
+            }
+            vm_push(*value);
+            break;
+        }
+        case OP_CODE_DEFINE_GLOBAL:
+        {
+            Token *name = READ_NAME();
+            table_set(&vm.globals, name->name, vm_pop());
+            break;
+        }
+        case OP_CODE_SET_GLOBAL:
+        {
+            Token *name = READ_NAME();
+            Literal *value = table_get(&vm.globals, name->name);
+            if (value == NULL)
+            {
+                vm_runtime_error("Undefined variable '%s'.", name->name->chars);
+                return VM_RESULT_RUNTIME_ERROR;
+            }
+            *value = vm_peek(0);
+            break;
+        }
+        case OP_CODE_GET_UPVALUE:
+            vm_push(*frame->closure->upvalues[READ_BYTE()]->location);
+            break;
+        case OP_CODE_SET_UPVALUE:
+            *frame->closure->upvalues[READ_BYTE()]->location = vm_peek(0);
+            break;
+        case OP_CODE_EQUAL:
+        {
+            Literal right = vm_pop();
+            Literal left = vm_pop();
+            vm_push(literal_bool(literal_is_equal(left, right)));
+            break;
+        }
+        case OP_CODE_GREATER:
+        {
+            double right = literal_as_number(vm_pop());
+            double left = literal_as_number(vm_pop());
+            vm_push(literal_bool(left > right));
+            break;
+        }
+        case OP_CODE_GREATER_EQUAL:
+        {
+            double right = literal_as_number(vm_pop());
+            double left = literal_as_number(vm_pop());
+            vm_push(literal_bool(left >= right));
+            break;
+        }
+        case OP_CODE_LESS:
+        {
+            double right = literal_as_number(vm_pop());
+            double left = literal_as_number(vm_pop());
+            vm_push(literal_bool(left < right));
+            break;
+        }
+        case OP_CODE_LESS_EQUAL:
+        {
+            double right = literal_as_number(vm_pop());
+            double left = literal_as_number(vm_pop());
+            vm_push(literal_bool(left <= right));
+            break;
+        }
+        case OP_CODE_ADD:
+        {
+            Literal right = vm_peek(0);
+            Literal left = vm_peek(1);
+
+            if (literal_is_number(left) && literal_is_number(right))
+            {
+                vm.stack_top -= 2;
+                vm_push(literal_number(literal_as_number(left) + literal_as_number(right)));
+            }
+            else if (literal_is_string(left) && literal_is_string(right))
+            {
+                // Both operands stay on the stack until the result exists.
+                Literal result = literal_concatenate(left, right);
+                vm.stack_top -= 2;
+                vm_push(result);
+            }
+            else
+            {
+                vm.stack_top -= 2;
+                vm_push(literal_none());
+            }
+            break;
+        }
+        case OP_CODE_SUBTRACT:
+        {
+            double right = literal_as_number(vm_pop());
+            double left = literal_as_number(vm_pop());
+            vm_push(literal_number(left - right));
+            break;
+        }
+        case OP_CODE_MULTIPLY:
+        {
+            double right = literal_as_number(vm_pop());
+            double left = literal_as_number(vm_pop());
+            vm_push(literal_number(left * right));
+            break;
+        }
+        case OP_CODE_DIVIDE:
+        {
+            double right = literal_as_number(vm_pop());
+            double left = literal_as_number(vm_pop());
+            vm_push(literal_number(left / right));
+            break;
+        }
+        case OP_CODE_NOT:
+            vm_push(literal_bool(!literal_is_truthy(vm_pop())));
+            break;
+        case OP_CODE_NEGATE:
+            vm.stack_top[-1] = literal_number(-literal_as_number(vm.stack_top[-1]));
+            break;
+        case OP_CODE_PRINT:
+            literal_print(vm_pop());
+            break;
+        case OP_CODE_JUMP:
+        {
+            uint16_t offset = READ_SHORT();
+            ip += offset;
+            break;
+        }
+        case OP_CODE_JUMP_IF_FALSE:
+        {
+            uint16_t offset = READ_SHORT();
+            if (!literal_is_truthy(vm_peek(0)))
+            {
+                ip += offset;
+            }
+            break;
+        }
+        case OP_CODE_LOOP:
+        {
+            uint16_t offset = READ_SHORT();
+            ip -= offset;
+            break;
+        }
+        case OP_CODE_CALL:
+        {
+            size_t arguments_count = READ_BYTE();
+            frame->ip = ip;
+            if (!vm_call(vm_peek(arguments_count), arguments_count))
+            {
+                return VM_RESULT_RUNTIME_ERROR;
+            }
+            frame = &vm.frames[vm.frames_count - 1];
+            ip = frame->ip;
+            break;
+        }
+        case OP_CODE_TAIL_CALL:
+        {
+            // The callee and its arguments replace the returning frame.
+            size_t arguments_count = READ_BYTE();
+            Literal *callee = vm.stack_top - arguments_count - 1;
+            vm_close_upvalues(frame->slots);
+            memmove(frame->slots, callee, (arguments_count + 1) * sizeof(Literal));
+            vm.stack_top = frame->slots + arguments_count + 1;
+            vm.frames_count--;
+            if (!vm_call(*frame->slots, arguments_count))
+            {
+                return VM_RESULT_RUNTIME_ERROR;
+            }
+            frame = &vm.frames[vm.frames_count - 1];
+            ip = frame->ip;
+            break;
+        }
+        case OP_CODE_CLOSURE:
+        {
+            CompiledFunction *function = literal_as_compiled_function(READ_CONSTANT());
+            ObjectClosure *closure = object_new_compiled_closure(function, function->upvalue_count);
+            // On the stack before capturing, so a collection keeps it alive.
+            vm_push(literal_function(closure));
+            for (size_t i = 0; i < closure->upvalue_count; ++i)
+            {
+                bool is_local = READ_BYTE();
+                uint8_t index = READ_BYTE();
+                closure->upvalues[i] = is_local ? vm_capture_upvalue(frame->slots + index) : frame->closure->upvalues[index];
+            }
+            break;
+        }
+        case OP_CODE_CLOSE_UPVALUE:
+            vm_close_upvalues(vm.stack_top - 1);
+            vm_pop();
+            break;
+        case OP_CODE_RETURN:
+        {
+            Literal result = vm_pop();
+            vm_close_upvalues(frame->slots);
+            vm.frames_count--;
+            if (vm.frames_count == 0)
+            {
+                vm_pop();
+                return VM_RESULT_OK;
+            }
+
+            vm.stack_top = frame->slots;
+            vm_push(result);
+            frame = &vm.frames[vm.frames_count - 1];
+            ip = frame->ip;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+#undef READ_BYTE
+#undef READ_SHORT
+#undef READ_CONSTANT
+#undef READ_NAME
+}
+
+static void vm_runtime_error(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+
+    for (size_t i = vm.frames_count; i > 0; --i)
+    {
+        if (vm.frames_count - i == VM_TRACE_MAX && i > 1)
+        {
+            fprintf(stderr, "... %zu more\n", i - 1);
+            i = 1;
+        }
+
+        CompiledFunction *function = vm.frames[i - 1].function;
+        if (function->name == NULL)
+        {
+            fprintf(stderr, "in script\n");
+        }
+        else
+        {
+            fprintf(stderr, "in %s\n", function->name->name->chars);
+        }
+    }
+
+    vm.stack_top = vm.stack;
+    vm.frames_count = 0;
+    vm.open_upvalues = NULL;
+}
+
+static void vm_push(Literal literal)
+{
+    *vm.stack_top++ = literal;
+}
+
+static Literal vm_pop(void)
+{
+    return *--vm.stack_top;
+}
+
+static Literal vm_peek(size_t distance)
+{
+    return vm.stack_top[-1 - (long)distance];
+}
+
+static bool vm_call(Literal callee, size_t arguments_count)
+{
+    CompiledFunction *function;
+    ObjectClosure *closure = NULL;
+    if (literal_is_compiled_function(callee))
+    {
+        function = literal_as_compiled_function(callee);
+    }
+    else if (literal_is_function(callee))
+    {
+        closure = literal_as_function(callee);
+        function = closure->compiled;
+    }
+    else
+    {
+        vm_runtime_error("Can only call functions.");
+        return false;
+    }
+
+    if (arguments_count != function->arity)
+    {
+        vm_runtime_error("Wrong number of arguments to '%s'.", function->name->name->chars);
+        return false;
+    }
+
+    if (vm.frames_count == vm.max_depth)
+    {
+        vm_runtime_error("Stack overflow.");
+        return false;
+    }
+
+    if (vm.frames_count == vm.frames_capacity)
+    {
+        vm.frames_capacity = vm.frames_capacity * 2 < vm.max_depth ? vm.frames_capacity * 2 : vm.max_depth;
+        vm.frames = realloc(vm.frames, vm.frames_capacity * sizeof(CallFrame));
+    }
+
+    // Pushes are unchecked, so the frame gets all the room it can use now.
+    size_t needed = (size_t)(vm.stack_top - vm.stack) - arguments_count - 1 + function->max_stack;
+    if (needed > vm.stack_capacity)
+    {
+        vm_grow_stack(needed);
+    }
+
+    CallFrame *frame = &vm.frames[vm.frames_count++];
+    frame->function = function;
+    frame->closure = closure;
+    frame->ip = function->chunk.code;
+    frame->slots = vm.stack_top - arguments_count - 1;
+    return true;
+}
+
+static void vm_grow_stack(size_t needed)
+{
+    // Frames and open upvalues point into the stack, so they are rebased
+    // onto the new copy before the old one is released.
+    while (vm.stack_capacity < needed)
+    {
+        vm.stack_capacity *= 2;
+    }
+
+    Literal *stack = malloc(vm.stack_capacity * sizeof(Literal));
+    memcpy(stack, vm.stack, (size_t)(vm.stack_top - vm.stack) * sizeof(Literal));
+    vm.stack_top = stack + (vm.stack_top - vm.stack);
+    for (size_t i = 0; i < vm.frames_count; ++i)
+    {
+        vm.frames[i].slots = stack + (vm.frames[i].slots - vm.stack);
+    }
+    for (ObjectUpvalue *upvalue = vm.open_upvalues; upvalue != NULL; upvalue = upvalue->next)
+    {
+        upvalue->location = stack + (upvalue->location - vm.stack);
+    }
+
+    free(vm.stack);
+    vm.stack = stack;
+}
+
+static ObjectUpvalue *vm_capture_upvalue(Literal *local)
+{
+    // Each slot has at most one open upvalue, so closures over the same
+    // variable share it.
+    ObjectUpvalue *previous = NULL;
+    ObjectUpvalue *upvalue = vm.open_upvalues;
+    while (upvalue != NULL && upvalue->location > local)
+    {
+        previous = upvalue;
+        upvalue = upvalue->next;
+    }
+
+    if (upvalue != NULL && upvalue->location == local)
+    {
+        return upvalue;
+    }
+
+    ObjectUpvalue *created = object_new_upvalue(literal_none());
+    created->location = local;
+    created->next = upvalue;
+    if (previous == NULL)
+    {
+        vm.open_upvalues = created;
+    }
+    else
+    {
+        previous->next = created;
+    }
+    return created;
+}
+
+static void vm_close_upvalues(Literal *last)
+{
+    while (vm.open_upvalues != NULL && vm.open_upvalues->location >= last)
+    {
+        ObjectUpvalue *upvalue = vm.open_upvalues;
+        upvalue->value = *upvalue->location;
+        upvalue->location = &upvalue->value;
+        vm.open_upvalues = upvalue->next;
+    }
+}
+
+static void vm_mark_roots(void)
+{
+    for (Literal *slot = vm.stack; slot < vm.stack_top; ++slot)
+    {
+        memory_mark_literal(*slot);
+    }
+
+    for (ObjectUpvalue *upvalue = vm.open_upvalues; upvalue != NULL; upvalue = upvalue->next)
+    {
+        memory_mark_object((Object *)upvalue);
+    }
+
+    table_mark(&vm.globals);
+}
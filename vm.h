@@ -0,0 +1,14 @@
+#ifndef VM_H
+#define VM_H
+
+#include "chunk.h"
+
+typedef enum
+{
+    VM_RESULT_OK,
+    VM_RESULT_RUNTIME_ERROR,
+} VmResult;
+
+VmResult vm_interpret(CompiledFunction *function, size_t max_depth);
+
+#endif